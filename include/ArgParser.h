@@ -6,4 +6,7 @@ public:
     static Config parse(int argc, char* argv[]);
     static void print_help(const char* program_name);
     static bool is_valid_url(const std::string& url);
+
+    // "<n>[K|M|G]", binary multiples. False on anything else.
+    static bool parse_size(const std::string& value, uint64_t& size);
 };
\ No newline at end of file
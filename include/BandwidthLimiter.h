@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide token bucket that every transfer draws from in its write
+// path. Kept in GCRA form: the bucket is a single atomic "theoretical arrival
+// time", so taking tokens is one compare-and-swap and refilling is implicit
+// in the clock moving on. A transfer that gets no tokens pauses its handle
+// (CURL_WRITEFUNC_PAUSE) until the returned wait has passed.
+//
+// Transfers may also draw through a flow with a weight, an optional ceiling
+// and an optional group. The capped rate is split by weighted max-min
+// fairness: first between groups (and ungrouped flows), then between the
+// flows of each group. A flow that uses less than its share only keeps what
+// it uses, the rest goes to the others. Without a global rate only the
+// ceilings apply.
+class BandwidthLimiter {
+public:
+    static BandwidthLimiter& getInstance();
+
+    //0 removes the cap. burstBytes may pass at once after an idle spell
+    //(0 picks a tenth of a second of traffic, at least 64 KB)
+    void setRate(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+    uint64_t getRate() const { return rate_.load(std::memory_order_relaxed); }
+    bool enabled() const { return getRate() != 0; }
+
+    //Take tokens for bytes. Zero if granted, otherwise how long to wait
+    //before the same request can succeed.
+    std::chrono::nanoseconds acquire(size_t bytes);
+
+    //Register a flow. ceiling is in bytes/s (0 = none); flows of one group
+    //share the group's weight. Returns the id to acquire() through.
+    uint64_t addFlow(double weight, uint64_t ceiling = 0, const std::string& group = "");
+    void removeFlow(uint64_t flow);
+
+    //Weight of a whole group against other groups and ungrouped flows (default 1)
+    void setGroupWeight(const std::string& group, double weight);
+
+    //Same as acquire(bytes), also within the flow's share
+    std::chrono::nanoseconds acquire(size_t bytes, uint64_t flow);
+
+    //Current share of a flow in bytes/s, 0 when unlimited
+    uint64_t getFlowRate(uint64_t flow);
+
+private:
+    struct Flow {
+        double weight;
+        uint64_t ceiling;
+        std::string group;
+        uint64_t allocated;      //share from the last rebalance, 0 = unlimited
+        int64_t tat;
+        uint64_t windowBytes;    //granted since the last rebalance
+        bool backlogged;         //asked for more than it got since the last rebalance
+        int64_t blockedUntil;    //end of its last wait
+        bool fresh;              //no full window measured yet
+    };
+
+    //One contender in a water-filling round
+    struct Share {
+        double weight;
+        double cap;
+        double rate;
+    };
+
+    static void waterFill(double capacity, std::vector<Share>& shares);
+    void rebalance(int64_t now);
+    std::chrono::nanoseconds takeFlow(Flow& flow, size_t bytes, int64_t now, bool commit);
+
+    BandwidthLimiter();
+
+    // Prevent copying
+    BandwidthLimiter(const BandwidthLimiter&) = delete;
+    BandwidthLimiter& operator=(const BandwidthLimiter&) = delete;
+
+    static constexpr uint64_t MIN_BURST = 64 * 1024;
+    static constexpr int64_t REBALANCE_NS = 100 * 1000 * 1000;
+
+    std::atomic<uint64_t> rate_;
+    std::atomic<int64_t> burstNs_;   //how far ahead of the clock the bucket may run
+    std::atomic<int64_t> tat_;       //theoretical arrival time, steady clock ns
+
+    std::mutex flowMutex_;
+    std::unordered_map<uint64_t, Flow> flows_;
+    std::unordered_map<std::string, double> groupWeights_;
+    uint64_t nextFlow_;
+    int64_t lastRebalance_;
+    bool dirty_;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// BLAKE3 hash (default mode, 256-bit output).
+// The whole state is plain data, so it can be checkpointed with memcpy.
+class Blake3 {
+public:
+    static const size_t OUT_LEN = 32;
+
+    Blake3();
+
+    void reset();
+    void update(const void* data, size_t length);
+
+    // Does not modify the state, more data may follow
+    void finalize(uint8_t out[OUT_LEN]) const;
+
+private:
+    static const size_t BLOCK_LEN = 64;
+    static const size_t CHUNK_LEN = 1024;
+    static const size_t MAX_DEPTH = 54; // enough for 2^64 bytes
+
+    struct ChunkState {
+        uint32_t cv[8];
+        uint64_t counter;
+        uint8_t block[BLOCK_LEN];
+        uint8_t block_len;
+        uint8_t blocks_compressed;
+
+        size_t length() const { return BLOCK_LEN * blocks_compressed + block_len; }
+    };
+
+    void start_chunk(uint64_t counter);
+    void update_chunk(const uint8_t* input, size_t length);
+    void push_chunk_cv(uint32_t cv[8], uint64_t total_chunks);
+
+    ChunkState chunk_;
+    uint32_t cv_stack_[MAX_DEPTH][8];
+    uint8_t cv_stack_len_;
+};
@@ -1,19 +1,101 @@
 #pragma once
 #include <string>
 #include <filesystem>
+#include <cstdint>
+#include <memory>
+
+enum class ChecksumAlgorithm {
+    Sha256,
+    Sha512,
+    Sha1,
+    Blake3,
+    Xxh3,    // XXH3 64-bit
+    Crc32c
+};
+
+// Incremental hash of one algorithm. Every implementation keeps its state
+// as plain data, so it can be saved and restored for resumed downloads.
+class Hasher {
+public:
+    virtual ~Hasher() = default;
+
+    virtual void update(const void* data, size_t length) = 0;
+
+    // Digest of everything hashed so far (more data may follow)
+    virtual std::string hex_digest() const = 0;
+
+    // Raw midstate, only meaningful to the same build on the same architecture
+    virtual size_t state_size() const = 0;
+    virtual const void* state() const = 0;
+    virtual void restore(const void* state) = 0;
+};
 
 class Checksum {
 public:
+    // New hasher, using the fastest kernel this CPU supports
+    static std::unique_ptr<Hasher> create_hasher(ChecksumAlgorithm algorithm);
+
+    // Parse "algo:hex". Without a prefix the algorithm is guessed from the
+    // digest length, defaulting to SHA-256. False for an unknown algorithm.
+    static bool parse_spec(const std::string& spec, ChecksumAlgorithm& algorithm, std::string& hex);
+
+    static bool parse_algorithm(const std::string& name, ChecksumAlgorithm& algorithm);
+    static std::string algorithm_name(ChecksumAlgorithm algorithm);
+    static size_t digest_hex_length(ChecksumAlgorithm algorithm);
+
+    // Compute the hex digest of a file (empty if it can't be read)
+    static std::string compute(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm);
+
+    // Hex digest of bytes [offset, offset + length) of a file (empty if any are missing)
+    static std::string compute_range(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm,
+                                     uint64_t offset, uint64_t length);
+
+    // Verify file against an expected hex digest (case-insensitive)
+    static bool verify(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm,
+                       const std::string& expected_hash);
+
     // Compute SHA-256 hash of a file
     static std::string compute_sha256(const std::filesystem::path& file_path);
-    
+
     // Verify file against expected SHA-256 hash (case-insensitive)
-    static bool verify_sha256(const std::filesystem::path& file_path, 
+    static bool verify_sha256(const std::filesystem::path& file_path,
                              const std::string& expected_hash);
-    
+
     // Convert bytes to hex string
     static std::string bytes_to_hex(const unsigned char* data, size_t length);
-    
+
     // Convert hex string to lowercase for comparison
     static std::string to_lowercase(const std::string& str);
-};
\ No newline at end of file
+};
+
+// Incremental checksum, fed with data as it is written to disk
+class ChecksumStream {
+public:
+    explicit ChecksumStream(ChecksumAlgorithm algorithm = ChecksumAlgorithm::Sha256);
+
+    // Start over, optionally switching algorithm
+    void reset();
+    void reset(ChecksumAlgorithm algorithm);
+
+    void update(const void* data, size_t length);
+
+    // Catch up by hashing bytes [bytes_hashed(), up_to) of a file (resumed prefix)
+    bool update_from_file(const std::filesystem::path& file_path, uint64_t up_to);
+
+    // Hex digest of everything hashed so far (the stream can keep going)
+    std::string hex_digest() const;
+
+    ChecksumAlgorithm algorithm() const { return algorithm_; }
+    uint64_t bytes_hashed() const { return bytes_; }
+
+    // Persist / restore the midstate so a resumed download skips rehashing
+    // its prefix. load_state rejects files from another algorithm, build or
+    // OpenSSL version.
+    bool save_state(const std::filesystem::path& state_path) const;
+    bool load_state(const std::filesystem::path& state_path);
+
+private:
+    ChecksumAlgorithm algorithm_;
+    std::unique_ptr<Hasher> hasher_;
+    uint64_t bytes_;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Checksum.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Expected digests of the fixed-size chunks of one file, bound together by a
+// Merkle root. A download checks each chunk as it lands and re-fetches only
+// the chunks that do not match, instead of the whole file.
+//
+// Text format, one field per line, then one digest per chunk in file order:
+//   chunkhash 1
+//   algorithm sha256
+//   chunk_size 4194304
+//   size 21474836480
+//   root <hex>
+//   <hex of chunk 0>
+//   ...
+class ChunkManifest {
+public:
+    static constexpr uint64_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    ChunkManifest();
+
+    // Read a manifest. Rejected unless its chunk digests hash up to its root.
+    bool load(const std::filesystem::path& path);
+    bool save(const std::filesystem::path& path) const;
+
+    // Hash a local (known good) file chunk by chunk
+    bool build(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm, uint64_t chunk_size);
+
+    ChecksumAlgorithm algorithm() const { return algorithm_; }
+    uint64_t chunk_size() const { return chunk_size_; }
+    uint64_t size() const { return size_; }
+    size_t chunk_count() const { return digests_.size(); }
+    const std::string& root() const { return root_; }
+
+    uint64_t chunk_offset(size_t index) const { return index * chunk_size_; }
+    uint64_t chunk_length(size_t index) const;
+    size_t chunk_at(uint64_t offset) const { return static_cast<size_t>(offset / chunk_size_); }
+
+    // Compare a digest computed for one chunk with the expected one
+    bool matches(size_t index, const std::string& hex) const;
+
+    // Read one chunk back from a file and check it
+    bool verify_chunk(const std::filesystem::path& file_path, size_t index) const;
+
+    // Root of the binary tree over the chunk digests: a node hashes the raw
+    // digests of its two children, an odd node is carried up unchanged
+    static std::string merkle_root(ChecksumAlgorithm algorithm, const std::vector<std::string>& digests);
+
+private:
+    ChecksumAlgorithm algorithm_;
+    uint64_t chunk_size_;
+    uint64_t size_;
+    std::string root_;
+    std::vector<std::string> digests_;
+};
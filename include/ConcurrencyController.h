@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+// AIMD tuning of how many transfers run at once. Once per interval the
+// manager hands over what it observed; the controller probes one more slot
+// while aggregate goodput keeps improving, steps back when an extra slot only
+// split the same goodput thinner, and cuts multiplicatively on errors or when
+// time to first byte climbs well above its baseline.
+class ConcurrencyController {
+public:
+    struct Sample {
+        double goodput;       // bytes/s over the interval, all transfers
+        size_t active;
+        size_t queued;
+    };
+
+    struct Decision {
+        size_t limit;
+        bool changed;
+        std::string reason;
+    };
+
+    ConcurrencyController(size_t initial, size_t minimum, size_t maximum);
+
+    //Thread-safe, called from transfer callbacks between updates
+    void recordError();
+    void recordLatency(double seconds);
+
+    Decision update(const Sample& sample);
+
+    size_t getLimit() const { return limit_.load(); }
+
+private:
+    enum class Action {
+        Hold,
+        Increase,
+        Decrease
+    };
+
+    static constexpr double LATENCY_FACTOR = 2.0;   //over baseline counts as congestion
+    static constexpr double DECREASE_FACTOR = 0.75;
+    static constexpr double MIN_GAIN = 0.05;        //goodput gain that justifies a slot
+
+    Decision decrease(size_t limit, const std::string& why, int cooldown);
+
+    std::atomic<size_t> limit_;
+    size_t minimum_;
+    size_t maximum_;
+
+    //Observations since the last update
+    std::mutex mutex_;
+    size_t errors_;
+    double latencySum_;
+    size_t latencyCount_;
+
+    //update() only
+    Action lastAction_;
+    double lastGoodput_;
+    double lastPerStream_;
+    double baselineLatency_;
+    int cooldown_;
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include <string>
+#include <cstdint>
+#include <map>
 
 struct Config {
     std::string url;
@@ -9,9 +11,37 @@ struct Config {
     int connect_timeout_seconds;
     bool show_help;
 
-    std::string expected_checksum;
+    std::string expected_checksum;     // hex digest, without the "algo:" prefix
+    std::string checksum_algorithm;    // sha256, sha512, sha1, blake3, xxh3, crc32c
     bool verify_checksum;
     std::string default_download_dir;
+    int segments;
+
+    // Batch mode: one "URL [output]" per line, run through DownloadManager
+    std::string input_file;
+    int max_concurrent;
+    int adaptive_max_concurrent;       // > 0: tune concurrency between 1 and this, starting at max_concurrent
+    int max_per_host;                  // > 0: transfers allowed at once against one host
+
+    // Verify mode: check every "<hash>  <file>" line of a SHA256SUMS-style file
+    std::string verify_manifest;
+    std::string manifest_algorithm;    // "" = from the manifest's name, then the digest length
+
+    // Per-chunk verification: check a download against a chunk manifest and
+    // re-fetch only corrupt chunks, or write a manifest for a local file
+    std::string chunk_manifest;
+    std::string make_chunk_manifest;
+    uint64_t chunk_size;
+
+    // Batch mode: NDJSON task events to a file descriptor number or a path
+    std::string events;
+
+    // Global bandwidth cap shared by every transfer (0 = unlimited)
+    uint64_t max_bytes_per_second;
+    uint64_t burst_bytes;
+
+    // Batch mode: share of each task group under the cap (group -> weight)
+    std::map<std::string, double> group_weights;
 
     Config()
         : url("")
@@ -21,7 +51,21 @@ struct Config {
         , connect_timeout_seconds(30)
         , show_help(false)
         , expected_checksum("")
+        , checksum_algorithm("sha256")
         , verify_checksum(false)
         , default_download_dir(".")
+        , segments(1)
+        , input_file("")
+        , max_concurrent(4)
+        , adaptive_max_concurrent(0)
+        , max_per_host(0)
+        , verify_manifest("")
+        , manifest_algorithm("")
+        , chunk_manifest("")
+        , make_chunk_manifest("")
+        , chunk_size(4 * 1024 * 1024)
+        , events("")
+        , max_bytes_per_second(0)
+        , burst_bytes(0)
         {}
 };
\ No newline at end of file
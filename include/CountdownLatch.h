@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// One-shot barrier: waiters block until countDown() has been called count
+// times or their deadline passes (C++17 has no std::latch).
+class CountdownLatch {
+public:
+    explicit CountdownLatch(size_t count)
+        : count_(count)
+    {
+    }
+
+    CountdownLatch(const CountdownLatch&) = delete;
+    CountdownLatch& operator=(const CountdownLatch&) = delete;
+
+    void countDown() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ > 0 && --count_ == 0) {
+            reached_.notify_all();
+        }
+    }
+
+    //True if the count reached zero before the timeout
+    bool waitFor(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return reached_.wait_for(lock, timeout, [this] { return count_ == 0; });
+    }
+
+    size_t remaining() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+private:
+    size_t count_;
+    mutable std::mutex mutex_;
+    std::condition_variable reached_;
+};
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli). Uses the SSE4.2 / ARMv8 CRC instructions when the
+// CPU has them, a table otherwise.
+class Crc32c {
+public:
+    // Continue a running CRC; start from 0
+    static uint32_t update(uint32_t crc, const void* data, size_t length);
+};
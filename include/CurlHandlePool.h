@@ -0,0 +1,62 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide pool of reusable curl easy handles. Handles are attached to a
+// CURLSH that shares the DNS cache, TLS sessions and the connection cache, so
+// consecutive transfers to the same host skip the TCP and TLS handshakes.
+//
+// libcurl does not support sharing connections between concurrently running
+// threads, so the pool keeps one share ("lane") per thread that drives
+// transfers. Acquire handles on the thread that will perform them (the
+// TransferEngine loop thread); release may happen anywhere.
+class CurlHandlePool {
+public:
+    static CurlHandlePool& getInstance();
+
+    //Get a reset handle for url, preferring one that last talked to the same host
+    CURL* acquire(const std::string& url);
+
+    //Give a handle back for reuse. It must not be attached to a multi handle.
+    void release(CURL* handle);
+
+private:
+    CurlHandlePool();
+    ~CurlHandlePool();
+
+    // Prevent copying
+    CurlHandlePool(const CurlHandlePool&) = delete;
+    CurlHandlePool& operator=(const CurlHandlePool&) = delete;
+
+    struct Lane {
+        CURLSH* share;
+        std::mutex locks[CURL_LOCK_DATA_LAST];
+        std::unordered_map<std::string, std::vector<CURL*>> idle; //by hostFromUrl
+        size_t idleCount;
+    };
+
+    struct Owner {
+        Lane* lane;
+        std::string host;
+    };
+
+    static void lockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockShare(CURL* handle, curl_lock_data data, void* userptr);
+
+    Lane* laneForThisThread();
+
+    //Idle handles kept per lane, beyond that released handles are freed
+    static const size_t MAX_IDLE_PER_LANE = 256;
+    //Connections a shared cache keeps open for reuse
+    static const long MAX_CACHED_CONNECTIONS = 256;
+
+    std::mutex mutex_;
+    std::unordered_map<std::thread::id, std::unique_ptr<Lane>> lanes_;
+    std::unordered_map<CURL*, Owner> owners_; //handles currently handed out
+};
@@ -5,18 +5,55 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include "DownloadTask.h"
 #include "ThreadPool.h"
 #include "HttpClient.h"
+#include "TransferEngine.h"
+#include "ProgressAggregator.h"
+#include "EventStream.h"
+#include "ConcurrencyController.h"
+#include "RunQueue.h"
 
 class DownloadManager {
 public:
+    //Stable handle of a task: its position, as in getTask() and in events
+    using TaskId = size_t;
+
     explicit DownloadManager(size_t maxConcurrent = 4);
 
     ~DownloadManager();
 
-    //Add a download to the queue
-    void addDownload(const std::string& url, const std::string& destination, int retryCount = 3, int timeoutSeconds = 300, const std::string& checksum = "");
+    //Add a download to the queue. Under a global rate cap the task gets a
+    //share proportional to weight (within its group, if any), never more
+    //than maxBytesPerSecond (0 = no ceiling)
+    TaskId addDownload(const std::string& url, const std::string& destination, int retryCount = 3, int timeoutSeconds = 300, const std::string& checksum = "", int segments = 1,
+                     double weight = 1.0, uint64_t maxBytesPerSecond = 0, const std::string& group = "");
+
+    //Share of a whole group against other groups and ungrouped tasks (default 1)
+    void setGroupWeight(const std::string& group, double weight);
+
+    //Let a controller move the concurrency limit between minConcurrent and
+    //maxConcurrent from observed goodput, errors and latency. Call before start().
+    void setAdaptiveConcurrency(size_t minConcurrent, size_t maxConcurrent,
+                                std::chrono::milliseconds interval = std::chrono::seconds(2));
+    size_t getMaxConcurrent() const { return maxConcurrent_.load(); }
+
+    //Pause in place for up to maxHold: the transfer stops reading but keeps its
+    //connections and TLS sessions, and a resume continues on them. Held longer,
+    //it falls back to closing them and resuming with a range request. While
+    //held a task keeps its slot and waitForCompletion waits for it.
+    //0 (the default) always closes them right away.
+    void setPauseHold(std::chrono::milliseconds maxHold);
+
+    //Downloads allowed at once against one host (0 = no limit). Free slots go
+    //to the host with the fewest active downloads. Call before start().
+    void setMaxPerHost(size_t maxPerHost);
 
     //Start processing the download queue
     void start();
@@ -24,43 +61,144 @@ public:
     //Wait for all downloads to complete
     void waitForCompletion();
 
-    //Get status
+    //Get status (counters, no task list walk)
     size_t getActiveCount() const;
     size_t getQueuedCount() const;
     size_t getCompletedCount() const;
     size_t getTotalCount() const;
+    size_t getStateCount(DownloadState state) const;
+
+    std::shared_ptr<DownloadTask> getTask(TaskId id) const;
+
+    //Report task transitions (queued, started, retry, paused, completed, failed)
+    //to an event stream. Not owned; set before adding downloads.
+    void setEventStream(EventStream* events) { events_ = events; }
 
-    std::shared_ptr<DownloadTask> getTask(size_t index) const;
+    //Bytes, sizes and smoothed throughput of every started, unfinished task
+    //(in TaskId order), and totals of the whole manager. Costs O(live tasks),
+    //not O(all tasks), so it can be polled on a timer.
+    ProgressAggregator::Snapshot getProgress();
 
-    //Pause/resume by URL or Index
+    //Pause/resume/cancel by handle; each is a constant-time lookup. Pause and
+    //cancel interrupt the transfer even while it is connecting or stalled;
+    //cancel also deletes the .part file.
+    void pauseDownload(TaskId id);
+    void resumeDownload(TaskId id);
+    void cancelDownload(TaskId id);
+
+    //By URL: the first task added with it (hash lookup), for callers without a handle
     void pauseDownload(const std::string& url);
     void resumeDownload(const std::string& url);
-    void pauseAll();
+
+    //Bulk pause: signal every task at once, then wait for all of their workers
+    //on one barrier with one deadline. True if every one stopped in time.
+    bool pauseDownloads(const std::vector<TaskId>& ids, std::chrono::milliseconds timeout = std::chrono::seconds(5));
+    bool pauseAll(std::chrono::milliseconds timeout = std::chrono::seconds(5));
     void resumeAll();
 
 private:
 //Process next task from queue
     void processNextTask();
 
-    //Worker function that downloads a task
+    //Hand a task to the transfer engine
     void downloadTask(std::shared_ptr<DownloadTask> task);
 
-    //Thread pool for concurrent downloads
+    //Record the outcome of a task and start the next one
+    void finishTask(std::shared_ptr<DownloadTask> task, bool success);
+
+    //Adaptive concurrency: feed the controller once per interval and apply its limit
+    void runController();
+    void stopController();
+
+    //Bytes downloaded by every task so far; caller holds taskMutex_
+    size_t bytesSoFar() const;
+
+    //Fold a task that reached a final state out of live_; caller holds taskMutex_
+    void retireTask(const std::shared_ptr<DownloadTask>& task);
+
+    //Lookup by handle or URL, nullptr if there is no such task
+    std::shared_ptr<DownloadTask> findTask(TaskId id) const;
+    std::shared_ptr<DownloadTask> findTask(const std::string& url) const;
+
+    //Stop a task's transfer in the engine now rather than at its next callback
+    void interruptTask(const std::shared_ptr<DownloadTask>& task);
+
+    //Pause a task and hold or stop its transfer; false if it wasn't downloading
+    bool requestPause(const std::shared_ptr<DownloadTask>& task, const std::shared_ptr<CountdownLatch>& stopped);
+
+    //Engine thread, once a hold is in place: the pause is acknowledged and reported
+    void holdStarted(const std::shared_ptr<DownloadTask>& task);
+
+    //Engine thread, when a hold runs out: true to close the connections
+    bool expireHold(TaskId id);
+
+    void pauseTask(const std::shared_ptr<DownloadTask>& task);
+    bool pauseTasks(const std::vector<std::shared_ptr<DownloadTask>>& tasks, std::chrono::milliseconds timeout);
+    void resumeTask(const std::shared_ptr<DownloadTask>& task);
+
+    //Forward a transition to the event stream, if there is one
+    void emitEvent(EventStream::Type type, const std::shared_ptr<DownloadTask>& task, const std::string& message = "", int attempt = 0);
+
+    //Thread pool for blocking post-download work (checksum verification)
     ThreadPool pool_;
 
-    //All tasks (queued, active, completed)
+    //Drives all transfers from a single event loop thread
+    TransferEngine engine_;
+
+    //All tasks (queued, active, completed), indexed by TaskId
     std::vector<std::shared_ptr<DownloadTask>> tasks_;
+    std::unordered_map<std::string, TaskId> urlIndex_;  //First task per URL
+    //Running transfers. held makes shouldContinue() keep a paused transfer
+    //alive while it is held in place; only changed under taskMutex_.
+    //heldReported: its Paused event went out when the hold took effect
+    struct InFlight {
+        TransferEngine::TransferId transfer;
+        std::shared_ptr<std::atomic<bool>> held;
+        bool heldReported = false;
+    };
+    std::unordered_map<TaskId, InFlight> inFlight_;
+    std::unordered_set<TaskId> resumeWhenStopped_;  //Resumed before their transfer wound down
+    //Tasks started and not yet finished (downloading, held or paused), so
+    //byte counts never walk tasks_; finished ones are folded into the totals below
+    std::map<TaskId, std::shared_ptr<DownloadTask>> live_;
+    size_t finishedBytes_;
+    size_t finishedTotalBytes_;     //Sizes of finished tasks whose size was known
+    std::chrono::milliseconds maxHold_;  //Guarded by taskMutex_
     mutable std::mutex taskMutex_;
 
+    //Queued tasks by host, and each host's active downloads. Guarded by taskMutex_
+    RunQueue runQueue_;
+
     //Active download tracking
     std::atomic<size_t> activeCount_;
-    size_t maxConcurrent_;
+    std::atomic<size_t> maxConcurrent_;
+    size_t maxPerHost_;
+
+    //Adaptive concurrency (optional)
+    std::unique_ptr<ConcurrencyController> controller_;
+    std::chrono::milliseconds controllerInterval_;
+    std::thread controllerThread_;
+    std::mutex controllerMutex_;
+    std::condition_variable controllerWake_;
+    bool controllerStop_;
 
     //Synchronization
-    std::condition_variable workAvailable_;
     std::atomic<bool> running_;
 
     //Counters
     std::atomic<size_t> completedCount_;
+    std::atomic<size_t> totalCount_;
+    TaskStateCounts stateCounts_;
+
+    //Tasks whose outcome finishTask has yet to record; waitForCompletion
+    //returns when it drops to zero
+    std::atomic<size_t> outstanding_;
+    std::mutex doneMutex_;
+    std::condition_variable allDone_;
+
+    //Throughput, derived from the tasks' progress counters
+    ProgressAggregator progress_;
+
+    EventStream* events_;
     
 };
\ No newline at end of file
@@ -4,7 +4,10 @@
 #include <atomic>
 #include <mutex>
 #include <chrono>
+#include <condition_variable>
+#include <memory>
 #include "Config.h"
+#include "CountdownLatch.h"
 
 enum class DownloadState{
     Queued,
@@ -15,18 +18,53 @@ enum class DownloadState{
     Canceled
 };
 
+// Number of tasks in each state. Tasks attached to it keep it current on every
+// transition, so status queries never have to walk the task list.
+class TaskStateCounts {
+public:
+    TaskStateCounts();
+
+    size_t get(DownloadState state) const;
+
+    void add(DownloadState state);
+    void move(DownloadState from, DownloadState to);
+
+private:
+    static constexpr size_t STATE_COUNT = static_cast<size_t>(DownloadState::Canceled) + 1;
+    std::atomic<size_t> counts_[STATE_COUNT];
+};
+
 class DownloadTask {
 public:
-    DownloadTask(const std::string& url, const std::string& destination, int retryCount, int timeoutSeconds, const std::string& checksum);
+    DownloadTask(const std::string& url, const std::string& destination, int retryCount, int timeoutSeconds, const std::string& checksum, int segments = 1,
+                 double weight = 1.0, uint64_t maxBytesPerSecond = 0, const std::string& group = "");
+
+    //Count this task (and every later transition) in counts. Not owned; set
+    //once, before the task is shared with other threads.
+    void setStateCounts(TaskStateCounts* counts);
+
+    //Handle assigned by the owning DownloadManager (its position in the manager)
+    void setId(size_t id) { id_ = id; }
+    size_t getId() const { return id_; }
 
     //State management (must be thread-sage)
     void start();
-    void pause();
-    void resume();
+    bool resume();
     void cancel();
     void markCompleted();
     void markFailed(const std::string& errorMessage);
 
+    //Paused -> Queued, for a resume that has to wait for a free slot
+    bool requeue();
+
+    //Ask the worker to stop. The pause only counts once the worker has
+    //acknowledged it; stopped (if given) is counted down then. False if the
+    //task was not downloading.
+    bool pause(const std::shared_ptr<CountdownLatch>& stopped = nullptr);
+
+    //Called by the worker once it has stopped writing, whatever the outcome
+    void acknowledgeStop();
+
     //Getters (must be thread-safe)
     DownloadState getState() const;
     std::string getUrl() const { return url_; };
@@ -37,8 +75,18 @@ public:
     int getTimeoutSeconds() const { return timeoutSeconds_; }
     int getConnectTimeoutSeconds() const { return connectTimeoutSeconds_; }
     std::string getExpectedChecksum() const { return expectedChecksum_; }
+    int getSegments() const { return segments_; }
+
+    //Bandwidth share: weight within its group (or against other tasks), optional ceiling
+    double getWeight() const { return weight_; }
+    uint64_t getMaxBytesPerSecond() const { return maxBytesPerSecond_; }
+    std::string getGroup() const { return group_; }
+
+    //Origin the transfer connects to ("host:port"), for per-host scheduling
+    const std::string& getHost() const { return host_; }
     bool shouldVerifyChecksum() const { return !expectedChecksum_.empty(); }
     bool shouldContinue() const;
+    //Wait for the worker's acknowledgement; true if the task ended up paused
     bool waitForPause(std::chrono::milliseconds timeout = std::chrono::seconds(5));
     
 
@@ -57,13 +105,26 @@ private:
     int timeoutSeconds_;
     int connectTimeoutSeconds_;
     std::string expectedChecksum_;
+    int segments_;
+    double weight_;
+    uint64_t maxBytesPerSecond_;
+    std::string group_;
+    std::string host_;
+    size_t id_;
 
     //State (atomic for lock-free reads)
     std::atomic<DownloadState> state_;
+    TaskStateCounts* stateCounts_;
+
+    //Every state change goes through these so stateCounts_ stays exact
+    bool transition(DownloadState& expected, DownloadState to);
+    void transition(DownloadState to);
 
-    //Progress (atomics for lock-free reads)
-    std::atomic<size_t> bytesDownloaded_;
-    std::atomic<size_t> totalBytes_;
+    //Progress (atomics for lock-free reads). Written by the transfer on every
+    //callback, so each gets its own cache line instead of sharing state_'s
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> bytesDownloaded_;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> totalBytes_;
 
     //Error info (needs mutex because string isnt atomic)
     std::string errorMessage_;
@@ -72,9 +133,13 @@ private:
     //timing 
     std::chrono::steady_clock::time_point startTime_;
 
+    //Worker acknowledgement. Transitions into and out of Downloading also take
+    //pauseMutex_, so an acknowledgement always belongs to the current run
     mutable std::condition_variable pauseConfirmed_;
     mutable std::mutex pauseMutex_;
+    bool stopAcknowledged_;
+    std::shared_ptr<CountdownLatch> stopLatch_;
 };
 
 //Helper function to convert state to string
-std::string stateToString(DownloadState state);
\ No newline at end of file
+std::string stateToString(DownloadState state);
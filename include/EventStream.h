@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "LockFreeQueue.h"
+#include "ProgressAggregator.h"
+
+// Newline-delimited JSON events for orchestration (--events=fd|path).
+//
+// Producers (task state transitions, retries) push into a lock-free queue and
+// return immediately; one background thread formats and writes. When the queue
+// is full they spill into a locked overflow list instead, so no lifecycle event
+// is ever lost. Progress is
+// not pushed at all: the writer samples the task counters itself, at most
+// once per progress interval, and reports the tasks that moved.
+//
+//   {"ts":1700000000123,"event":"completed","task":3,"url":"...","output":"..."}
+class EventStream {
+public:
+    enum class Type {
+        Queued,
+        Started,
+        Progress,
+        Retry,
+        Paused,
+        Completed,
+        Failed,
+        Canceled
+    };
+
+    struct Event {
+        Type type;
+        size_t task;
+        std::string url;
+        std::string output;
+        uint64_t bytes;
+        uint64_t total;
+        double rate;
+        int attempt;
+        std::string message;
+        int64_t timeMs;
+    };
+
+    explicit EventStream(std::chrono::milliseconds progressInterval = std::chrono::milliseconds(500));
+    ~EventStream();
+
+    //Target is a file descriptor number or a file path (appended to)
+    bool open(const std::string& target);
+    bool usesFd(int fd) const { return fd_ == fd; }
+
+    //Where progress events come from, sampled by the writer thread
+    void setProgressSource(std::function<ProgressAggregator::Snapshot()> source);
+
+    //Thread-safe. Only takes a lock when the writer has fallen behind the queue;
+    //progress samples are dropped (and counted) then, everything else waits in overflow.
+    void emit(Type type, size_t task, const std::string& url, const std::string& output,
+              const std::string& message = "", int attempt = 0);
+
+    //Write everything still queued, then stop the writer
+    void close();
+
+    static const char* typeName(Type type);
+
+private:
+    static const size_t QUEUE_CAPACITY = 8192;
+
+    void run();
+    void writeProgress(std::string& batch);
+    void append(std::string& batch, const Event& event);
+    void writeAll(const std::string& batch);
+    static int64_t nowMs();
+
+    LockFreeQueue<Event> queue_;
+    std::mutex overflowMutex_;
+    std::deque<Event> overflow_;    //newer than anything in queue_ while overflowing_
+    std::atomic<bool> overflowing_;
+    std::chrono::milliseconds progressInterval_;
+    std::function<ProgressAggregator::Snapshot()> progressSource_;
+
+    int fd_;
+    bool ownsFd_;
+    std::thread writer_;
+    std::atomic<bool> running_;
+    std::atomic<bool> sleeping_;
+    std::atomic<size_t> dropped_;
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+
+    //Writer thread only: last bytes reported per task
+    std::unordered_map<const DownloadTask*, size_t> reported_;
+};
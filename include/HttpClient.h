@@ -5,48 +5,242 @@
 #include <chrono>
 #include <filesystem> // cross platform file/dir operations
 #include <thread>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <array>
 #include "Config.h"
+#include "Checksum.h"
+#include "ChunkManifest.h"
 
 enum class ErrorType {
     Transient,
     Permanent,
     Success
 };
+
+// Outcome of a finished easy handle, as seen by the driver of the transfer
+enum class TransferStatus {
+    Running,    // other handles still in flight, add any take_ready_handles()
+    RetryLater, // transient failure, call retry_handle() after retry_delay()
+    Restart,    // drop every handle and call begin_attempt() again
+    Succeeded,
+    Failed,
+    Stopped     // aborted because shouldContinue() returned false (pause)
+};
+
 class CurlHttpClient{
 public:
     CurlHttpClient();
     ~CurlHttpClient();
-    
+
     bool download_file(std::string& url, std::string& output_path, int max_retries = 3, int timeout = 300, int connect_timeout = 30, std::function<bool()> shouldContinue = nullptr);
     bool download_and_verify(const Config& config, std::function<bool()> shouldContinue = nullptr);
 
+    // Checksum verification (and quarantine on mismatch) of a finished download.
+    // actual_hash is the digest computed while downloading, if any; when empty
+    // the file is read back and hashed.
+    static bool verify_download(const Config& config, const std::string& actual_hash = "");
+
+    // Split files with a known size into this many ranges fetched in parallel
+    void set_segments(int count) { segment_count = count; }
+
+    // Hash data as it is written (with the algorithm the config verifies
+    // against) so verification needs no second pass
+    void set_stream_checksum(const Config& config);
+
+    // Digest of the finished file if it was hashed while downloading, else empty
+    const std::string& get_streamed_checksum() const { return streamed_checksum; }
+
+    // Check fixed-size chunks against config.chunk_manifest as they land and
+    // re-fetch only the corrupt ones. False if the manifest can't be loaded.
+    bool set_chunk_manifest(const Config& config);
+
+    // Draw the progress bar on stdout (off when something else renders progress)
+    void set_show_progress(bool show) { show_progress = show; }
+
+    // Called when a failed attempt (or segment) is about to be retried
+    void set_retry_listener(std::function<void(int, const std::string&)> listener) { retry_listener = std::move(listener); }
+
+    // Called (on the driving thread) when a handle paused itself because the
+    // BandwidthLimiter had no tokens; it must be unpaused at the given time
+    void set_pause_listener(std::function<void(CURL*, std::chrono::steady_clock::time_point)> listener) { pause_listener = std::move(listener); }
+
+    // Draw bandwidth through a BandwidthLimiter flow (weighted share, ceiling)
+    void set_bandwidth_flow(uint64_t flow) { bandwidth_flow = flow; }
+
+    // Called on every progress update with bytes on disk and the full size (-1 if unknown)
+    void set_progress_listener(std::function<void(curl_off_t, curl_off_t)> listener) { progress_listener = std::move(listener); }
+
+    // Non-blocking attempt API, driven by TransferEngine
+    bool prepare(const std::string& url, const std::string& output_path, int max_retries, int timeout, int connect_timeout, std::function<bool()> shouldContinue);
+    bool begin_attempt();
+    std::vector<CURL*> take_ready_handles();
+    TransferStatus finish_handle(CURL* easy, CURLcode res);
+    bool retry_handle(CURL* easy);
+    std::chrono::seconds retry_delay() const { return std::chrono::seconds(retry_delay_seconds); }
+    const std::string& get_url() const { return url; }
+
+    // Abort at the next chance, as if shouldContinue() had returned false.
+    // Driving thread only; the driver then finishes the handles as usual.
+    void stop() { should_stop = true; }
+
+    // Delete the .part file of output_path and its resume state (cancel)
+    static void remove_partial(const std::filesystem::path& output_path);
+
+    // Learned from response headers (-1 / empty until known)
+    curl_off_t get_content_length() const { return content_length; }
+    const std::string& get_etag() const { return etag; }
+    const std::string& get_last_modified() const { return last_modified; }
+
     static size_t write_data(void *ptr, size_t size, size_t nmemb, FILE* stream);
 
     static int progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
 
-    static std::string format_bytes(curl_off_t bytes); 
+    static std::string format_bytes(curl_off_t bytes);
+
 
-    
 private:
     struct WriteContext
     {
+        CurlHttpClient* client;
         FILE* file;
         std::function<bool()> shouldContinue;
         bool* shouldStop;
     };
 
+    // Running hash of the chunk a sequential writer is currently filling
+    struct ChunkCursor
+    {
+        std::unique_ptr<Hasher> hasher;
+        size_t index;
+        uint64_t filled;         // bytes of the chunk written so far
+        bool whole;              // chunk was hashed from its first byte
+    };
+
+    enum class ChunkState : uint8_t {
+        Unchecked,
+        Good,
+        Bad
+    };
+
+    // One byte range of a segmented download, written at its own offset
+    struct Segment
+    {
+        CurlHttpClient* client;
+        CURL* handle;
+        FILE* file;
+        curl_off_t start;        // first byte of the range
+        curl_off_t end;          // last byte of the range (inclusive)
+        curl_off_t written;      // bytes already at their offset in the file
+        int attempt;
+        bool done;
+        bool range_checked;      // 206 seen for the current attempt
+        bool range_ignored;      // server answered the range with a full body
+        ChunkCursor chunks;
+
+        curl_off_t length() const { return end - start + 1; }
+    };
+
+    enum class Mode {
+        Probe,     // HEAD to learn the size before splitting
+        Single,
+        Segmented
+    };
+
     static size_t write_data_with_check(void *ptr, size_t size, size_t nmemb, void* userdata);
-    
+    static size_t write_segment(void *ptr, size_t size, size_t nmemb, void* userdata);
+    static size_t header_callback(char *buffer, size_t size, size_t nitems, void* userdata);
+    static int segment_progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
     static const int MAX_RETRIES = 3;
+    static const curl_off_t MIN_SEGMENT_SIZE = 1024 * 1024;
+    // How often segment progress and the checksum midstate are persisted
+    static constexpr std::chrono::seconds CHECKPOINT_INTERVAL{1};
 
     CURL *curl;
     std::chrono::steady_clock::time_point start_time;
     curl_off_t last_dlnow;
     std::chrono::steady_clock::time_point last_time;
     bool progress_complete;
+    bool show_progress;
     curl_off_t resume_from;
 
+    // Request and per-attempt state
+    std::string url;
+    std::filesystem::path final_path;
+    std::filesystem::path temp_path;
+    int max_retries;
+    int timeout;
+    int connect_timeout;
+    std::function<bool()> should_continue;
+    std::function<void(curl_off_t, curl_off_t)> progress_listener;
+    std::function<void(int, const std::string&)> retry_listener;
+    std::function<void(CURL*, std::chrono::steady_clock::time_point)> pause_listener;
+    uint64_t bandwidth_flow;
+    int attempt;
+    int retry_delay_seconds;
+    FILE* fp;
+    bool should_stop;
+    WriteContext write_ctx;
+    std::vector<CURL*> ready_handles;
+
+    // Response metadata, captured by header_callback
+    curl_off_t content_length;
+    bool accept_ranges;
+    std::string etag;
+    std::string last_modified;
+    long header_status;
+    std::string pending_etag;
+    std::string pending_last_modified;
+    curl_slist* request_headers;
+    bool body_started;
+    bool out_of_space;
+
+    // Hash-while-downloading (single connection only, segments land out of order)
+    bool stream_checksum;
+    ChecksumStream stream_hash;
+    std::string streamed_checksum;
+
+    // Per-chunk verification and repair
+    bool check_chunks;
+    ChunkManifest chunk_manifest;
+    std::vector<ChunkState> chunk_states;
+    ChunkCursor chunk_cursor;
+    curl_off_t write_offset;
+    int repair_round;
+
+    // Segmented mode
+    Mode mode;
+    int segment_count;
+    curl_off_t session_base;
+    std::chrono::steady_clock::time_point last_checkpoint;
+    std::vector<std::unique_ptr<Segment>> segments;
+
+    bool begin_single();
+    TransferStatus finish_single(CURLcode res);
+    void begin_probe();
+    TransferStatus finish_probe(CURLcode res);
+    bool begin_segmented();
+    bool arm_segment(Segment& segment);
+    TransferStatus finish_segment(Segment& segment, CURLcode res);
+    void close_segments();
+    bool load_segment_state();
+    void save_segment_state();
+    void write_segment_state(const std::vector<std::array<curl_off_t, 3>>& ranges);
+    std::filesystem::path segment_state_path() const;
+    std::filesystem::path hash_state_path() const;
+    void save_hash_state();
+    static ChecksumAlgorithm checksum_algorithm(const Config& config);
+    void hash_chunks(ChunkCursor& cursor, curl_off_t offset, const void* data, size_t length);
+    TransferStatus verify_chunks();
+    void render_progress(curl_off_t downloaded, curl_off_t total, curl_off_t session_bytes);
+
+    bool throttle(CURL* handle, size_t bytes);
+    bool on_first_body_bytes();
+    void set_if_range(CURL* handle);
+    void reserve_space(FILE* file, curl_off_t offset, curl_off_t length);
     bool ensure_dir_exists(const std::filesystem::path& file_path);
     bool check_disk_space(const std::filesystem::path& file_path, curl_off_t required_bytes);
     ErrorType classify_error(CURLcode curl_error, long http_code);
-};
\ No newline at end of file
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Checksum.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bulk verification of a SHA256SUMS-style manifest ("<hex>  <path>" per
+// line, as written by sha256sum/sha512sum/b3sum). SHA-256 and BLAKE3 digests
+// are both 64 hex characters, so the algorithm comes from the caller or the
+// manifest's name (B3SUMS, SHA512SUMS, ...) before the digest length. Files are hashed in
+// parallel, with at most maxPerDevice concurrent readers per storage device
+// so spinning disks are not thrashed while SSDs are kept busy.
+class ManifestVerifier {
+public:
+    struct Entry {
+        std::filesystem::path path;
+        std::string name;            // as written in the manifest
+        ChecksumAlgorithm algorithm;
+        std::string expected;
+        uint64_t device;
+        uint64_t size;               // UINT64_MAX if the file can't be stat'ed
+    };
+
+    struct Summary {
+        size_t files;
+        size_t passed;
+        size_t mismatched;
+        size_t unreadable;
+        size_t malformed;
+        uint64_t bytes;
+        double seconds;
+    };
+
+    explicit ManifestVerifier(size_t maxPerDevice);
+
+    //Read the manifest. Relative paths are resolved against its directory.
+    //algorithm names the digests of every line; "" infers it from the file name.
+    bool load(const std::filesystem::path& manifest, const std::string& algorithm = "");
+
+    //Algorithm implied by a manifest name like "B3SUMS" or "SHA512SUMS.txt"
+    static bool algorithmFromName(const std::filesystem::path& manifest, ChecksumAlgorithm& algorithm);
+
+    //Hash every entry, printing failures as they are found
+    Summary run();
+
+    size_t getEntryCount() const { return entries_.size(); }
+
+private:
+    //Verify files from one device's list until it is exhausted
+    void drain(const std::vector<const Entry*>& files, std::atomic<size_t>& cursor);
+    void verifyEntry(const Entry& entry);
+    //Small SHA-256 files, hashed side by side in SIMD lanes
+    void verifyBatch(const std::vector<const Entry*>& batch);
+    void report(const Entry& entry, const std::string& actual);
+    static void statEntry(Entry& entry);
+
+    //Files up to this size are read whole and batched when lanes pay off
+    static const uint64_t SMALL_FILE_LIMIT = 256 * 1024;
+
+    bool useLanes_;
+
+    size_t maxPerDevice_;
+    std::vector<Entry> entries_;
+    size_t malformed_;
+
+    std::atomic<size_t> passed_;
+    std::atomic<size_t> mismatched_;
+    std::atomic<size_t> unreadable_;
+    std::atomic<uint64_t> bytes_;
+    std::mutex outputMutex_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "DownloadTask.h"
+
+// Computes per-task and global throughput from the byte counters transfers
+// publish into their DownloadTask. Transfers only store two relaxed atomics;
+// every rate is derived here, by whoever samples (one caller at a time).
+class ProgressAggregator {
+public:
+    struct TaskProgress {
+        std::shared_ptr<DownloadTask> task;
+        DownloadState state;
+        size_t bytesDownloaded;
+        size_t totalBytes;        // 0 while the size is unknown
+        double bytesPerSecond;    // smoothed
+        double etaSeconds;        // -1 when unknown
+    };
+
+    struct Snapshot {
+        std::vector<TaskProgress> tasks;
+        size_t bytesDownloaded;
+        size_t totalBytes;        // over tasks whose size is known
+        double bytesPerSecond;
+        size_t active;
+    };
+
+    //Rates are an exponentially weighted moving average with this time constant
+    explicit ProgressAggregator(std::chrono::milliseconds smoothing = std::chrono::seconds(2));
+
+    Snapshot sample(const std::vector<std::shared_ptr<DownloadTask>>& tasks);
+    Snapshot sample(const std::vector<std::shared_ptr<DownloadTask>>& tasks, std::chrono::steady_clock::time_point now);
+
+private:
+    struct Rate {
+        size_t lastBytes;
+        std::chrono::steady_clock::time_point lastTime;
+        double bytesPerSecond;
+    };
+
+    std::chrono::duration<double> smoothing_;
+    std::unordered_map<const DownloadTask*, Rate> rates_;
+    std::mutex mutex_;
+};
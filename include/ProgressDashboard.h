@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProgressAggregator.h"
+
+class DownloadManager;
+
+// Multi-row terminal view of a DownloadManager: a totals line plus one bar per
+// running task. A single thread samples the task counters at a fixed rate and
+// rewrites only the rows that changed, so transfers never touch the console.
+//
+// While it runs, std::cout and std::cerr are captured and their complete lines
+// are printed above the dashboard on the next frame.
+class ProgressDashboard {
+public:
+    explicit ProgressDashboard(DownloadManager& manager, std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+    ~ProgressDashboard();
+
+    //True when stdout is a terminal (the dashboard is pointless otherwise)
+    static bool isTerminal();
+
+    void start();
+
+    //Draw a last frame and give the console back
+    void stop();
+
+private:
+    //Collects text written to std::cout / std::cerr from any thread
+    class CaptureBuffer : public std::streambuf {
+    public:
+        std::string takeLines();
+        std::string takeAll();
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char* data, std::streamsize count) override;
+
+    private:
+        std::mutex mutex_;
+        std::string text_;
+    };
+
+    void run();
+    void renderFrame(bool final);
+    std::vector<std::string> buildLines(const ProgressAggregator::Snapshot& snapshot, size_t width, size_t height) const;
+    static void terminalSize(size_t& width, size_t& height);
+
+    DownloadManager& manager_;
+    std::chrono::milliseconds interval_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool running_;
+
+    CaptureBuffer capture_;
+    std::streambuf* stdout_;     //the real console, owned by std::cout while not capturing
+    std::streambuf* stderr_;
+    std::vector<std::string> drawn_;
+};
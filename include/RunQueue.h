@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include "DownloadTask.h"
+
+// Queued tasks, indexed for the scheduler: one FIFO per host plus an ordered
+// set of the hosts that have work, keyed by (active downloads, age of the
+// oldest queued task). pop() hands out the oldest task of the least busy host
+// that still has a free slot in O(log hosts). Not thread-safe; the owner
+// serializes access.
+class RunQueue {
+public:
+    //Downloads allowed at once against one host (0 = no limit)
+    explicit RunQueue(size_t maxPerHost = 0);
+
+    void setMaxPerHost(size_t maxPerHost);
+
+    //Append a queued task behind the others of its host
+    void push(std::shared_ptr<DownloadTask> task);
+
+    //Take the next task to start and count it against its host. Tasks that
+    //left the Queued state while waiting are dropped. nullptr when nothing is
+    //queued or every host with work is at its limit.
+    std::shared_ptr<DownloadTask> pop();
+
+    //True if the host is below its limit, so a download may start without pop()
+    bool hasSlot(const std::string& host) const;
+
+    //Count a download started without pop() (resume), or one that ended
+    void claim(const std::string& host);
+    void release(const std::string& host);
+
+    //Entries still held, including ones pop() has yet to drop
+    size_t size() const { return size_; }
+
+private:
+    struct Host {
+        std::deque<std::pair<uint64_t, std::shared_ptr<DownloadTask>>> ready;
+        size_t active = 0;
+    };
+
+    using HostMap = std::unordered_map<std::string, Host>;
+    using Key = std::tuple<size_t, uint64_t, const std::string*>;
+
+    //Take a host out of / put it back into order_ around every change
+    void unlink(HostMap::iterator host);
+    void link(HostMap::iterator host);
+
+    size_t maxPerHost_;
+    HostMap hosts_;
+    std::set<Key> order_;   //Hosts with queued tasks only
+    uint64_t nextSeq_;
+    size_t size_;
+};
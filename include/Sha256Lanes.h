@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Multi-buffer SHA-256: hashes several independent messages at once, one
+// per SIMD lane (8 x 32-bit lanes, AVX2 where available). Pays off for
+// batches of small files on CPUs without the SHA extensions, where a single
+// stream leaves most of the vector unit idle.
+class Sha256Lanes {
+public:
+    static constexpr size_t LANES = 8;
+    static constexpr size_t DIGEST_LEN = 32;
+
+    // Hash count (<= LANES) messages, writing one digest per message
+    static void hash(const uint8_t* const data[], const size_t lengths[], size_t count,
+                     uint8_t digests[][DIGEST_LEN]);
+
+    // Whether lane hashing beats one-at-a-time hashing on this CPU
+    static bool preferred();
+};
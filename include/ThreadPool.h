@@ -1,14 +1,23 @@
 #pragma once
 
 #include <vector>
-#include <queue>
+#include <deque>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <future>
 #include <memory>
+#include <stdexcept>
+#include "LockFreeQueue.h"
+#include "WorkStealingDeque.h"
 
+// Work-stealing pool. Each worker owns a deque: tasks enqueued from inside a
+// task go to the bottom of the current worker's deque and are popped LIFO,
+// idle workers steal from the top of a random victim's. Tasks enqueued from
+// outside the pool go through a shared lock-free injection queue. Workers
+// that find nothing spin briefly, then park on a condition variable.
 class ThreadPool {
 public:
     explicit ThreadPool(size_t numThreads);
@@ -19,16 +28,51 @@ public:
     auto enqueue(Func&& func, Args&&... args) -> std::future<typename std::result_of<Func(Args...)>::type>;
 
 private:
+    using Job = std::function<void()>;
+
+    struct Worker {
+        WorkStealingDeque<Job*> deque;
+        uint64_t rng;
+    };
+
+    //Queue a type-erased job, throws once the pool is stopping
+    void submit(Job job);
+
+    void workerLoop(size_t index);
+
+    //Next job for a worker: its own deque, then injected jobs, then a steal
+    Job* findJob(Worker& self);
+    Job* stealJob(Worker& self);
+    Job* takeInjected();
+    bool hasWork() const;
+
+    void park();
+    void wakeOne();
+
+    static void run(Job* job);
+
+    static constexpr size_t INJECTION_CAPACITY = 4096;
+    static constexpr int SPIN_ROUNDS = 64;  //Empty searches before parking
+
+    std::vector<std::unique_ptr<Worker>> queues_;
     std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
 
-    std::mutex queueMutex_;
+    //Jobs enqueued from outside the pool; overflow_ only when the ring is full
+    LockFreeQueue<Job*> injection_;
+    std::mutex overflowMutex_;
+    std::deque<Job*> overflow_;
+    std::atomic<size_t> overflowSize_;
+
+    //Parking
+    std::mutex parkMutex_;
     std::condition_variable condition_;
+    std::atomic<size_t> sleepers_;
+    uint64_t wakeups_; //Guarded by parkMutex_
 
-    bool stop_;
+    std::atomic<bool> stop_;
 };
 
-// Template implementation must be in header 
+// Template implementation must be in header
 template<typename Func, typename... Args>
 auto ThreadPool::enqueue(Func&& func, Args&&... args) -> std::future<typename std::result_of<Func(Args...)>::type> {
         using ReturnType = typename std::result_of<Func(Args...)>::type;
@@ -39,17 +83,7 @@ auto ThreadPool::enqueue(Func&& func, Args&&... args) -> std::future<typename st
 
         std::future<ReturnType> result = task->get_future();
 
-        {
-            std::unique_lock<std::mutex> lock(queueMutex_);
-
-            if(stop_) {
-                throw std::runtime_error("Cannot enqueue on stopped ThreadPool");
-            }
-
-            tasks_.emplace([task](){ (*task)(); });
-        }
-
-        condition_.notify_one();
+        submit([task](){ (*task)(); });
 
         return result;
-    }
\ No newline at end of file
+    }
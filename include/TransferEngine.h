@@ -0,0 +1,131 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class CurlHttpClient;
+
+// Event-driven transfer engine: drives any number of CurlHttpClient transfers
+// from a single thread through one curl multi handle. A transfer may own
+// several easy handles at once (segmented downloads).
+class TransferEngine {
+public:
+    using CompletionCallback = std::function<void(bool success)>;
+    using TransferId = uint64_t;
+    using HoldCallback = std::function<void()>;
+    using ExpiryCallback = std::function<bool()>;
+
+    TransferEngine();
+
+    ~TransferEngine();
+
+    //Drive transfers on a background thread until stop() is called
+    void start();
+    void stop();
+
+    //Drive transfers on the calling thread until none are left
+    void run();
+
+    //Hand a prepared client to the engine. Thread-safe, may be called from a
+    //completion callback. The client must outlive the transfer (onDone may own it).
+    //Returns an id for interrupt(); ids are never reused.
+    TransferId submit(CurlHttpClient* client, CompletionCallback onDone);
+
+    //Stop a transfer now, wherever it is: connecting, stalled, throttled or
+    //waiting to retry. It completes as stopped (onDone(false)) on the loop
+    //thread. Thread-safe; unknown or finished ids are ignored.
+    void interrupt(TransferId id);
+
+    //Pause a transfer in place (CURLPAUSE_RECV on every handle), keeping its
+    //connections and TLS sessions open. onHeld runs on the loop thread once the
+    //handles are paused. After maxHold, onExpire runs there too: if it returns
+    //true the transfer is stopped as by interrupt(). A transfer waiting to
+    //retry has no connection to keep and is offered to onExpire right away.
+    void hold(TransferId id, std::chrono::milliseconds maxHold, HoldCallback onHeld, ExpiryCallback onExpire);
+
+    //Continue a held transfer where it stopped
+    void release(TransferId id);
+
+    //Connections curl may open to one host at once, the rest of that host's
+    //handles wait inside the multi handle (0 = no limit). Call before start().
+    void setMaxHostConnections(long maxConnections);
+
+    //Transfers submitted but not yet completed
+    size_t getActiveCount() const;
+
+private:
+    struct Transfer {
+        TransferId id;
+        CurlHttpClient* client;
+        CompletionCallback onDone;
+        std::vector<CURL*> handles; //Handles currently added to the multi handle
+        bool held = false;
+        ExpiryCallback onExpire;
+    };
+
+    struct Command {
+        enum class Kind { Interrupt, Hold, Release };
+        Kind kind;
+        TransferId id;
+        std::chrono::milliseconds maxHold;
+        HoldCallback onHeld;
+        ExpiryCallback onExpire;
+    };
+
+    struct RetryTimer {
+        std::shared_ptr<Transfer> transfer;
+        CURL* handle;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    //Event loop, returns when stopped (or when idle if untilIdle is set)
+    void loop(bool untilIdle);
+
+    void addPending();
+    void processCommands();
+    void stopTransfer(const std::shared_ptr<Transfer>& transfer);
+    void holdTransfer(const std::shared_ptr<Transfer>& transfer, const Command& command);
+    void releaseTransfer(const std::shared_ptr<Transfer>& transfer);
+    void fireHoldTimers();
+    void sendCommand(Command command);
+    void beginAttempt(const std::shared_ptr<Transfer>& transfer);
+    bool addReadyHandles(const std::shared_ptr<Transfer>& transfer);
+    void processMessages();
+    void fireRetryTimers();
+    void fireThrottleTimers();
+    void dropThrottleTimers(CURL* easy);
+    void detachAll(const std::shared_ptr<Transfer>& transfer);
+    void complete(const std::shared_ptr<Transfer>& transfer, bool success);
+    void abortAll();
+    bool idle();
+    int nextTimeoutMs() const;
+
+    CURLM* multi_;
+    std::thread loopThread_;
+    std::atomic<bool> stop_;
+
+    //Submissions from other threads
+    std::mutex pendingMutex_;
+    std::vector<std::shared_ptr<Transfer>> pending_;
+    std::vector<Command> commands_;
+    TransferId nextId_;
+
+    //Owned by the loop thread
+    std::unordered_map<CURL*, std::shared_ptr<Transfer>> active_;
+    std::unordered_map<TransferId, std::shared_ptr<Transfer>> transfers_; //Every transfer not yet completed
+    std::multimap<Clock::time_point, RetryTimer> retryTimers_;
+    std::multimap<Clock::time_point, CURL*> throttleTimers_; //Handles paused by the bandwidth cap
+    std::multimap<Clock::time_point, TransferId> holdTimers_;  //Held transfers, by when they give up their connections
+
+    std::atomic<size_t> transferCount_;
+};
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+// Lowercased "host:port" of a URL, the port taken from the scheme if absent, so
+// "HTTP://Example.com" and "http://example.com:80" are one host. Credentials
+// are dropped. Returns "" if there is no host.
+//
+// The one definition of "same host": the run queue limits and the curl handle
+// pool match on it.
+std::string hostFromUrl(const std::string& url);
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chase-Lev work-stealing deque (with the C11 orderings of Le et al., 2013).
+// One owner thread pushes and pops at the bottom (LIFO), any thread may steal
+// from the top (FIFO). Grows without bound; outgrown buffers are kept until
+// destruction because a thief may still be reading them. T must be trivially
+// copyable, in practice a pointer.
+template<typename T>
+class WorkStealingDeque {
+public:
+    //capacity is rounded up to a power of two
+    explicit WorkStealingDeque(size_t capacity = 256);
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    //Owner only
+    void push(T value);
+    bool pop(T& value);
+
+    //Any thread. Also fails when it loses a race for the last item.
+    bool steal(T& value);
+
+    bool empty() const;
+
+private:
+    struct Buffer {
+        explicit Buffer(size_t size)
+            : mask(size - 1)
+            , slots(new std::atomic<T>[size])
+        {
+        }
+
+        size_t capacity() const { return mask + 1; }
+        T get(int64_t i) const { return slots[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T value) { slots[static_cast<size_t>(i) & mask].store(value, std::memory_order_relaxed); }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Buffer* grow(Buffer* buffer, int64_t bottom, int64_t top);
+
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top_;
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom_;
+    std::atomic<Buffer*> buffer_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;   //Current one last, owner only
+};
+
+// Template implementation must be in header
+template<typename T>
+WorkStealingDeque<T>::WorkStealingDeque(size_t capacity)
+    : top_(0)
+    , bottom_(0)
+{
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    buffers_.push_back(std::make_unique<Buffer>(size));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+}
+
+template<typename T>
+typename WorkStealingDeque<T>::Buffer* WorkStealingDeque<T>::grow(Buffer* buffer, int64_t bottom, int64_t top) {
+    auto bigger = std::make_unique<Buffer>(buffer->capacity() * 2);
+    for (int64_t i = top; i < bottom; ++i) {
+        bigger->put(i, buffer->get(i));
+    }
+
+    buffers_.push_back(std::move(bigger));
+    buffer_.store(buffers_.back().get(), std::memory_order_release);
+    return buffers_.back().get();
+}
+
+template<typename T>
+void WorkStealingDeque<T>::push(T value) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+
+    if (bottom - top >= static_cast<int64_t>(buffer->capacity())) {
+        buffer = grow(buffer, bottom, top);
+    }
+
+    buffer->put(bottom, value);
+    bottom_.store(bottom + 1, std::memory_order_release);
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::pop(T& value) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed); //Empty
+        return false;
+    }
+
+    value = buffer->get(bottom);
+    if (top == bottom) {
+        //Last item: race thieves for it
+        bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::steal(T& value) {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+        return false;
+    }
+
+    Buffer* buffer = buffer_.load(std::memory_order_acquire);
+    T stolen = buffer->get(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return false;
+    }
+
+    value = stolen;
+    return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::empty() const {
+    int64_t top = top_.load(std::memory_order_acquire);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    return top >= bottom;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// XXH3 64-bit hash (seed 0, default secret), streaming.
+// The whole state is plain data, so it can be checkpointed with memcpy.
+class Xxh3 {
+public:
+    Xxh3();
+
+    void reset();
+    void update(const void* data, size_t length);
+
+    // Does not modify the state, more data may follow
+    uint64_t digest() const;
+
+private:
+    static const size_t STRIPE_LEN = 64;
+    static const size_t BUFFER_SIZE = 256;
+
+    uint64_t acc_[8];
+    uint8_t buffer_[BUFFER_SIZE];
+    size_t buffered_;
+    size_t stripes_so_far_; // stripes accumulated in the current block
+    uint64_t total_len_;
+};
@@ -1,12 +1,18 @@
 #include "ArgParser.h"
 #include "ConfigManager.h"
+#include "Checksum.h"
 #include <iostream>
 #include <string>
+#include <cctype>
+#include <cstdint>
 
 void ArgParser::print_help(const char* program_name) {
     std::cout << "Download Manager v1.0\n\n";
     std::cout << "USAGE:\n";
     std::cout << "  " << program_name << " <URL [OPTIONS]\n";
+    std::cout << "  " << program_name << " --input-file <file> [OPTIONS]\n";
+    std::cout << "  " << program_name << " --verify-manifest <SHA256SUMS> [--algorithm <algo>] [-j <n>]\n";
+    std::cout << "  " << program_name << " --make-chunk-manifest <file> [--chunk-size <n>]\n";
     std::cout << "  " << program_name << " --help\n\n";
     
     std::cout << "ARGUEMENTS:\n";
@@ -17,7 +23,28 @@ void ArgParser::print_help(const char* program_name) {
     std::cout << "  -r, --retry-count <num> Number of retries on failure (default: 3)\n";
     std::cout << "  -t, --timeout <seconds> Download timeout in seconds (default: 300)\n";
     std::cout << "  -c, --connect-timeout <s>  Connection timeout in seconds (default: 30)\n";
-    std::cout << "  --checksum <hash>          Expected SHA-256 hash for verification\n"; 
+    std::cout << "  --checksum [algo:]<hash>   Expected hash for verification (default algo: sha256;\n";
+    std::cout << "                             also sha512, sha1, blake3, xxh3, crc32c)\n";
+    std::cout << "  -s, --segments <n>         Parallel connections per file (default: 1)\n";
+    std::cout << "  -i, --input-file <file>    Download every \"URL [output]\" line of a file; lines may\n";
+    std::cout << "                             add weight=<w> limit=<n>[K|M|G] group=<name>\n";
+    std::cout << "  -j, --max-concurrent <n>   Concurrent downloads in batch mode, or readers per\n";
+    std::cout << "                             storage device when verifying (default: 4)\n";
+    std::cout << "  --adaptive-concurrency <n> Batch mode: tune concurrency between 1 and n from\n";
+    std::cout << "                             throughput, errors and latency, starting at -j\n";
+    std::cout << "  --max-per-host <n>         Batch mode: downloads at once from one host, the\n";
+    std::cout << "                             rest of the slots go to other hosts (default: no limit)\n";
+    std::cout << "  --events=<fd|path>         Batch mode: write task events as NDJSON\n";
+    std::cout << "  --limit-rate <n>[K|M|G]    Cap total download speed in bytes/s (default: none)\n";
+    std::cout << "  --burst <n>[K|M|G]         Bytes allowed at once under --limit-rate\n";
+    std::cout << "                             (default: 0.1s worth, at least 64K)\n";
+    std::cout << "  --group-weight <name>=<w>  Batch mode: share of a task group (default: 1)\n";
+    std::cout << "  --verify-manifest <file>   Check the files listed in a SHA256SUMS-style file\n";
+    std::cout << "  --algorithm <algo>         Digest algorithm of the manifest (default: from its name,\n";
+    std::cout << "                             e.g. B3SUMS is blake3, else sha256 for 64 hex digits)\n";
+    std::cout << "  --chunk-manifest <file>    Verify each chunk as it lands, re-fetch only corrupt ones\n";
+    std::cout << "  --make-chunk-manifest <f>  Write <f>.chunks, the chunk manifest of a local file\n";
+    std::cout << "  --chunk-size <n>[K|M|G]    Chunk size for --make-chunk-manifest (default: 4M)\n";
     std::cout << "  -h, --help                 Show this help message\n\n";
 
     std::cout << "EXAMPLES:\n";
@@ -26,6 +53,48 @@ void ArgParser::print_help(const char* program_name) {
     std::cout << "  " << program_name << " http://example.com/file.zip --retry-count 5\n";
     std::cout << "  " << program_name << " http://example.com/file.zip -o output.zip -r 5 -t 600\n";
     std::cout << "  " << program_name << " http://example.com/file.zip --checksum abc123...\n";
+    std::cout << "  " << program_name << " http://example.com/file.zip --checksum blake3:abc123...\n";
+    std::cout << "  " << program_name << " http://example.com/image.iso --segments 8\n";
+    std::cout << "  " << program_name << " --input-file urls.txt -j 64\n";
+    std::cout << "  " << program_name << " --input-file urls.txt --adaptive-concurrency 128\n";
+    std::cout << "  " << program_name << " --input-file urls.txt -j 32 --max-per-host 4\n";
+    std::cout << "  " << program_name << " --input-file urls.txt --events=3 3>events.ndjson\n";
+    std::cout << "  " << program_name << " --input-file urls.txt --limit-rate 10M\n";
+    std::cout << "  " << program_name << " --input-file urls.txt --limit-rate 10M --group-weight mirror=0.25\n";
+    std::cout << "  " << program_name << " --verify-manifest /data/SHA256SUMS -j 8\n";
+    std::cout << "  " << program_name << " --verify-manifest /data/sums.txt --algorithm blake3\n";
+    std::cout << "  " << program_name << " --make-chunk-manifest image.iso\n";
+    std::cout << "  " << program_name << " http://example.com/image.iso --chunk-manifest image.iso.chunks\n";
+}
+
+bool ArgParser::parse_size(const std::string& value, uint64_t& size) {
+    //stoull would accept a sign ("-1" wraps around) or leading blanks
+    if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) {
+        return false;
+    }
+
+    try {
+        size_t digits = 0;
+        uint64_t parsed = std::stoull(value, &digits);
+        std::string suffix = value.substr(digits);
+        int shift = 0;
+        if (suffix == "K" || suffix == "k") {
+            shift = 10;
+        } else if (suffix == "M" || suffix == "m") {
+            shift = 20;
+        } else if (suffix == "G" || suffix == "g") {
+            shift = 30;
+        } else if (!suffix.empty()) {
+            return false;
+        }
+        if (parsed > (UINT64_MAX >> shift)) {
+            return false; //Would overflow
+        }
+        size = parsed << shift;
+        return true;
+    } catch (const std::exception& e) {
+        return false;
+    }
 }
 
 bool ArgParser::is_valid_url(const std::string& url) {
@@ -102,12 +171,22 @@ Config ArgParser::parse(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 std::string checksum_arg = argv[i + 1];
                 
-                // Check if it starts with "sha256:" (optional prefix)
-                if (checksum_arg.find("sha256:") == 0) {
-                    cli_config.expected_checksum = checksum_arg.substr(7);  // Skip "sha256:" prefix
-                } else {
-                    cli_config.expected_checksum = checksum_arg;
+                // "algo:hex", or a bare hex digest (SHA-256 unless its length says otherwise)
+                ChecksumAlgorithm algorithm;
+                std::string hex;
+                if (!Checksum::parse_spec(checksum_arg, algorithm, hex)) {
+                    std::cerr << "Error: unknown checksum algorithm in '" << checksum_arg << "'\n";
+                    std::cerr << "Supported: sha256, sha512, sha1, blake3, xxh3, crc32c\n";
+                    std::exit(1);
+                }
+                if (checksum_arg.find(':') != std::string::npos &&
+                    hex.size() != Checksum::digest_hex_length(algorithm)) {
+                    std::cerr << "Error: " << Checksum::algorithm_name(algorithm) << " checksum must be "
+                              << Checksum::digest_hex_length(algorithm) << " hex characters\n";
+                    std::exit(1);
                 }
+                cli_config.expected_checksum = hex;
+                cli_config.checksum_algorithm = Checksum::algorithm_name(algorithm);
                 
                 cli_config.verify_checksum = true;
                 i++;
@@ -155,6 +234,208 @@ Config ArgParser::parse(int argc, char* argv[]) {
                 std::exit(1);
             }
         }
+        else if (arg == "--segments" || arg == "-s") {
+            if (i + 1 < argc) {
+                try {
+                    cli_config.segments = std::stoi(argv[i + 1]);
+                    if (cli_config.segments <= 0) {
+                        std::cerr << "Error: segments must be positive\n";
+                        std::exit(1);
+                    }
+                    i++;
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: invalid segments value\n";
+                    std::exit(1);
+                }
+            } else {
+                std::cerr << "Error: --segments requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--input-file" || arg == "-i") {
+            if (i + 1 < argc) {
+                cli_config.input_file = argv[i + 1];
+                i++;
+            } else {
+                std::cerr << "Error: --input-file requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--verify-manifest") {
+            if (i + 1 < argc) {
+                cli_config.verify_manifest = argv[i + 1];
+                i++;
+            } else {
+                std::cerr << "Error: --verify-manifest requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--algorithm") {
+            if (i + 1 < argc) {
+                ChecksumAlgorithm algorithm;
+                if (!Checksum::parse_algorithm(argv[i + 1], algorithm)) {
+                    std::cerr << "Error: unknown checksum algorithm '" << argv[i + 1] << "'\n";
+                    std::cerr << "Supported: sha256, sha512, sha1, blake3, xxh3, crc32c\n";
+                    std::exit(1);
+                }
+                cli_config.manifest_algorithm = Checksum::algorithm_name(algorithm);
+                i++;
+            } else {
+                std::cerr << "Error: --algorithm requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg.compare(0, 9, "--events=") == 0) {
+            cli_config.events = arg.substr(9);
+            if (cli_config.events.empty()) {
+                std::cerr << "Error: --events requires a file descriptor or path\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--events") {
+            if (i + 1 < argc) {
+                cli_config.events = argv[i + 1];
+                i++;
+            } else {
+                std::cerr << "Error: --events requires a file descriptor or path\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--chunk-manifest") {
+            if (i + 1 < argc) {
+                cli_config.chunk_manifest = argv[i + 1];
+                i++;
+            } else {
+                std::cerr << "Error: --chunk-manifest requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--make-chunk-manifest") {
+            if (i + 1 < argc) {
+                cli_config.make_chunk_manifest = argv[i + 1];
+                i++;
+            } else {
+                std::cerr << "Error: --make-chunk-manifest requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--chunk-size") {
+            if (i + 1 < argc) {
+                if (!parse_size(argv[i + 1], cli_config.chunk_size)) {
+                    std::cerr << "Error: invalid chunk-size value\n";
+                    std::exit(1);
+                }
+                if (cli_config.chunk_size == 0) {
+                    std::cerr << "Error: chunk-size must be positive\n";
+                    std::exit(1);
+                }
+                i++;
+            } else {
+                std::cerr << "Error: --chunk-size requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--limit-rate") {
+            if (i + 1 < argc) {
+                if (!parse_size(argv[i + 1], cli_config.max_bytes_per_second)) {
+                    std::cerr << "Error: invalid limit-rate value\n";
+                    std::exit(1);
+                }
+                i++;
+            } else {
+                std::cerr << "Error: --limit-rate requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--group-weight") {
+            if (i + 1 < argc) {
+                std::string value = argv[i + 1];
+                size_t equals = value.find('=');
+                try {
+                    if (equals == 0 || equals == std::string::npos) {
+                        throw std::invalid_argument(value);
+                    }
+                    double weight = std::stod(value.substr(equals + 1));
+                    if (weight <= 0) {
+                        throw std::invalid_argument(value);
+                    }
+                    cli_config.group_weights[value.substr(0, equals)] = weight;
+                    i++;
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: --group-weight expects <name>=<positive weight>\n";
+                    std::exit(1);
+                }
+            } else {
+                std::cerr << "Error: --group-weight requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--burst") {
+            if (i + 1 < argc) {
+                if (!parse_size(argv[i + 1], cli_config.burst_bytes)) {
+                    std::cerr << "Error: invalid burst value\n";
+                    std::exit(1);
+                }
+                i++;
+            } else {
+                std::cerr << "Error: --burst requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--max-concurrent" || arg == "-j") {
+            if (i + 1 < argc) {
+                try {
+                    cli_config.max_concurrent = std::stoi(argv[i + 1]);
+                    if (cli_config.max_concurrent <= 0) {
+                        std::cerr << "Error: max-concurrent must be positive\n";
+                        std::exit(1);
+                    }
+                    i++;
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: invalid max-concurrent value\n";
+                    std::exit(1);
+                }
+            } else {
+                std::cerr << "Error: --max-concurrent requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--adaptive-concurrency") {
+            if (i + 1 < argc) {
+                try {
+                    cli_config.adaptive_max_concurrent = std::stoi(argv[i + 1]);
+                    if (cli_config.adaptive_max_concurrent <= 0) {
+                        std::cerr << "Error: adaptive-concurrency must be positive\n";
+                        std::exit(1);
+                    }
+                    i++;
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: invalid adaptive-concurrency value\n";
+                    std::exit(1);
+                }
+            } else {
+                std::cerr << "Error: --adaptive-concurrency requires a value\n";
+                std::exit(1);
+            }
+        }
+        else if (arg == "--max-per-host") {
+            if (i + 1 < argc) {
+                try {
+                    cli_config.max_per_host = std::stoi(argv[i + 1]);
+                    if (cli_config.max_per_host <= 0) {
+                        std::cerr << "Error: max-per-host must be positive\n";
+                        std::exit(1);
+                    }
+                    i++;
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: invalid max-per-host value\n";
+                    std::exit(1);
+                }
+            } else {
+                std::cerr << "Error: --max-per-host requires a value\n";
+                std::exit(1);
+            }
+        }
         else if (arg[0] == '-') {
             // Unknown flag
             std::cerr << "Error: unknown option '" << arg << "'\n";
@@ -174,6 +455,12 @@ Config ArgParser::parse(int argc, char* argv[]) {
             }
         }
     }
+    // Batch and verify modes take their work from a file
+    if (!cli_config.input_file.empty() || !cli_config.verify_manifest.empty() ||
+        !cli_config.make_chunk_manifest.empty()) {
+        return ConfigManager::merge_configs(file_config, cli_config);
+    }
+
     if (cli_config.url.empty()) {
         std::cerr << "Error: URL is required\n";
         print_help(argv[0]);
@@ -0,0 +1,255 @@
+#include "BandwidthLimiter.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+BandwidthLimiter::BandwidthLimiter()
+    : rate_(0)
+    , burstNs_(0)
+    , tat_(0)
+    , nextFlow_(1)
+    , lastRebalance_(0)
+    , dirty_(true)
+{
+}
+
+BandwidthLimiter& BandwidthLimiter::getInstance() {
+    static BandwidthLimiter instance;
+    return instance;
+}
+
+void BandwidthLimiter::setRate(uint64_t bytesPerSecond, uint64_t burstBytes) {
+    if (bytesPerSecond == 0) {
+        rate_.store(0);
+        return;
+    }
+
+    if (burstBytes == 0) {
+        burstBytes = std::max<uint64_t>(MIN_BURST, bytesPerSecond / 10);
+    }
+
+    burstNs_.store(static_cast<int64_t>(burstBytes * 1000000000.0 / bytesPerSecond));
+    tat_.store(steadyNowNs());
+    rate_.store(bytesPerSecond);
+
+    std::lock_guard<std::mutex> lock(flowMutex_);
+    dirty_ = true;
+}
+
+std::chrono::nanoseconds BandwidthLimiter::acquire(size_t bytes) {
+    uint64_t rate = rate_.load(std::memory_order_relaxed);
+    if (rate == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    int64_t now = steadyNowNs();
+    int64_t tolerance = burstNs_.load(std::memory_order_relaxed);
+    int64_t cost = static_cast<int64_t>(bytes * 1000000000.0 / rate);
+
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+        //An idle bucket only banks up to its burst
+        int64_t start = std::max(tat, now);
+        if (start - now > tolerance) {
+            return std::chrono::nanoseconds(start - now - tolerance);
+        }
+        if (tat_.compare_exchange_weak(tat, start + cost, std::memory_order_relaxed)) {
+            return std::chrono::nanoseconds(0);
+        }
+    }
+}
+
+uint64_t BandwidthLimiter::addFlow(double weight, uint64_t ceiling, const std::string& group) {
+    std::lock_guard<std::mutex> lock(flowMutex_);
+    uint64_t id = nextFlow_++;
+    flows_[id] = Flow{std::max(weight, 0.001), ceiling, group, 0, steadyNowNs(), 0, false, 0, true};
+    dirty_ = true;
+    return id;
+}
+
+void BandwidthLimiter::removeFlow(uint64_t flow) {
+    std::lock_guard<std::mutex> lock(flowMutex_);
+    flows_.erase(flow);
+    dirty_ = true;
+}
+
+void BandwidthLimiter::setGroupWeight(const std::string& group, double weight) {
+    std::lock_guard<std::mutex> lock(flowMutex_);
+    groupWeights_[group] = std::max(weight, 0.001);
+    dirty_ = true;
+}
+
+uint64_t BandwidthLimiter::getFlowRate(uint64_t flow) {
+    std::lock_guard<std::mutex> lock(flowMutex_);
+    if (dirty_) {
+        rebalance(steadyNowNs());
+    }
+    auto it = flows_.find(flow);
+    return it == flows_.end() ? 0 : it->second.allocated;
+}
+
+std::chrono::nanoseconds BandwidthLimiter::acquire(size_t bytes, uint64_t flow) {
+    std::lock_guard<std::mutex> lock(flowMutex_);
+
+    auto it = flows_.find(flow);
+    if (it == flows_.end()) {
+        return acquire(bytes);
+    }
+
+    int64_t now = steadyNowNs();
+    if (dirty_ || now - lastRebalance_ >= REBALANCE_NS) {
+        rebalance(now);
+    }
+
+    //Both the flow's share and the global bucket must have room; the flow is
+    //only charged once the global bucket has granted
+    Flow& state = it->second;
+    std::chrono::nanoseconds wait = takeFlow(state, bytes, now, false);
+    if (wait.count() == 0) {
+        wait = acquire(bytes);
+    }
+    if (wait.count() > 0) {
+        //Shares move with every rebalance, so never park a flow for longer
+        wait = std::min<std::chrono::nanoseconds>(wait, std::chrono::nanoseconds(REBALANCE_NS));
+        state.backlogged = true;
+        state.blockedUntil = now + wait.count();
+        return wait;
+    }
+
+    takeFlow(state, bytes, now, true);
+    state.windowBytes += bytes;
+    return std::chrono::nanoseconds(0);
+}
+
+std::chrono::nanoseconds BandwidthLimiter::takeFlow(Flow& flow, size_t bytes, int64_t now, bool commit) {
+    if (flow.allocated == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    int64_t tolerance = static_cast<int64_t>(std::max<uint64_t>(MIN_BURST, flow.allocated / 10) * 1000000000.0 / flow.allocated);
+    int64_t start = std::max(flow.tat, now);
+    if (start - now > tolerance) {
+        return std::chrono::nanoseconds(start - now - tolerance);
+    }
+    if (commit) {
+        flow.tat = start + static_cast<int64_t>(bytes * 1000000000.0 / flow.allocated);
+    }
+    return std::chrono::nanoseconds(0);
+}
+
+void BandwidthLimiter::waterFill(double capacity, std::vector<Share>& shares) {
+    std::vector<Share*> open;
+    for (Share& share : shares) {
+        share.rate = 0;
+        open.push_back(&share);
+    }
+
+    //Whoever wants less than a weighted share gets all it wants, the others
+    //split what is left, until nobody is below their share
+    while (!open.empty() && capacity > 0) {
+        double weights = 0;
+        for (Share* share : open) {
+            weights += share->weight;
+        }
+
+        std::vector<Share*> rest;
+        double used = 0;
+        for (Share* share : open) {
+            if (share->cap <= capacity * share->weight / weights) {
+                share->rate = share->cap;
+                used += share->cap;
+            } else {
+                rest.push_back(share);
+            }
+        }
+
+        if (rest.size() == open.size()) {
+            for (Share* share : open) {
+                share->rate = capacity * share->weight / weights;
+            }
+            return;
+        }
+        capacity -= used;
+        open.swap(rest);
+    }
+}
+
+void BandwidthLimiter::rebalance(int64_t now) {
+    const double unlimited = std::numeric_limits<double>::infinity();
+    double elapsed = std::max<int64_t>(now - lastRebalance_, 1) / 1e9;
+    uint64_t rate = getRate();
+
+    //What each flow could use: a backlogged (or still paused) or new flow
+    //takes all it is given, an idle one a little more than it moved last window
+    std::unordered_map<uint64_t, double> demand;
+    for (auto& entry : flows_) {
+        Flow& flow = entry.second;
+        double wants = unlimited;
+        if (!flow.fresh && !flow.backlogged && flow.blockedUntil < lastRebalance_ && !dirty_) {
+            wants = std::max<double>(flow.windowBytes / elapsed * 2, MIN_BURST);
+        }
+        if (flow.ceiling > 0) {
+            wants = std::min<double>(wants, flow.ceiling);
+        }
+        demand[entry.first] = wants;
+
+        flow.fresh = false;
+        flow.backlogged = false;
+        flow.windowBytes = 0;
+    }
+
+    if (rate == 0) {
+        //Nothing to divide, only the ceilings hold
+        for (auto& entry : flows_) {
+            entry.second.allocated = entry.second.ceiling;
+        }
+    } else {
+        //Top level: ungrouped flows and whole groups
+        std::vector<Share> top;
+        std::vector<std::vector<uint64_t>> members;
+        std::unordered_map<std::string, size_t> groupIndex;
+
+        for (auto& entry : flows_) {
+            const Flow& flow = entry.second;
+            if (flow.group.empty()) {
+                top.push_back(Share{flow.weight, demand[entry.first], 0});
+                members.push_back({entry.first});
+                continue;
+            }
+
+            auto group = groupIndex.find(flow.group);
+            if (group == groupIndex.end()) {
+                auto weight = groupWeights_.find(flow.group);
+                group = groupIndex.emplace(flow.group, top.size()).first;
+                top.push_back(Share{weight == groupWeights_.end() ? 1.0 : weight->second, 0, 0});
+                members.emplace_back();
+            }
+            top[group->second].cap += demand[entry.first];
+            members[group->second].push_back(entry.first);
+        }
+
+        waterFill(static_cast<double>(rate), top);
+
+        for (size_t i = 0; i < top.size(); ++i) {
+            std::vector<Share> inner;
+            for (uint64_t id : members[i]) {
+                inner.push_back(Share{flows_[id].weight, demand[id], 0});
+            }
+            waterFill(top[i].rate, inner);
+            for (size_t j = 0; j < inner.size(); ++j) {
+                flows_[members[i][j]].allocated = std::max<uint64_t>(1, static_cast<uint64_t>(inner[j].rate));
+            }
+        }
+    }
+
+    lastRebalance_ = now;
+    dirty_ = false;
+}
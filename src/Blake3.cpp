@@ -0,0 +1,304 @@
+#include "Blake3.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+// Message word order for each of the 7 rounds
+static const uint8_t MSG_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+enum : uint32_t {
+    CHUNK_START = 1 << 0,
+    CHUNK_END = 1 << 1,
+    PARENT = 1 << 2,
+    ROOT = 1 << 3,
+};
+
+static inline uint32_t load32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static inline void store32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+// The round function is written once as a macro so the scalar and the
+// multi-lane kernels share it. V is 32-bit scalar or a vector of lanes.
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define G(v, a, b, c, d, mx, my)            \
+    do {                                    \
+        v[a] = v[a] + v[b] + (mx);          \
+        v[d] = ROTR32(v[d] ^ v[a], 16);     \
+        v[c] = v[c] + v[d];                 \
+        v[b] = ROTR32(v[b] ^ v[c], 12);     \
+        v[a] = v[a] + v[b] + (my);          \
+        v[d] = ROTR32(v[d] ^ v[a], 8);      \
+        v[c] = v[c] + v[d];                 \
+        v[b] = ROTR32(v[b] ^ v[c], 7);      \
+    } while (0)
+
+#define ROUNDS(v, m)                                                  \
+    _Pragma("GCC unroll 7")                                           \
+    for (int r = 0; r < 7; r++) {                                     \
+        const uint8_t* s = MSG_SCHEDULE[r];                           \
+        G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);                          \
+        G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);                          \
+        G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);                         \
+        G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);                         \
+        G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);                         \
+        G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);                       \
+        G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);                        \
+        G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);                        \
+    }
+
+static void compress(const uint32_t cv[8], const uint8_t block[64], uint8_t block_len,
+                     uint64_t counter, uint32_t flags, uint32_t out[16]) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = load32(block + 4 * i);
+    }
+
+    uint32_t v[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        IV[0], IV[1], IV[2], IV[3],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+        block_len, flags
+    };
+
+    ROUNDS(v, m);
+
+    for (int i = 0; i < 8; i++) {
+        out[i] = v[i] ^ v[i + 8];
+        out[i + 8] = v[i + 8] ^ cv[i];
+    }
+}
+
+// Whole chunks hashed side by side, one chunk per vector lane, using the
+// GCC/Clang vector extensions. Built for AVX2 and baseline separately and
+// picked at load time where the toolchain supports it.
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define BLAKE3_HASH_MANY 1
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(__clang__)
+#define HASH_MANY_DISPATCH __attribute__((target_clones("avx2", "default")))
+#else
+#define HASH_MANY_DISPATCH
+#endif
+
+#if defined(__clang__)
+#define SHUFFLE(a, b, ...) __builtin_shufflevector(a, b, __VA_ARGS__)
+#else
+#define SHUFFLE(a, b, ...) __builtin_shuffle(a, b, lanes_u32{__VA_ARGS__})
+#endif
+
+static const size_t LANES = 8;
+typedef uint32_t lanes_u32 __attribute__((vector_size(4 * LANES)));
+
+// rows[l] holds 8 consecutive message words of lane l; afterwards rows[w]
+// holds word w of every lane
+static inline __attribute__((always_inline)) void transpose(lanes_u32 rows[8]) {
+    lanes_u32 a[4], b[4], c[4], d[4];
+    for (int k = 0; k < 4; k++) {
+        a[k] = SHUFFLE(rows[2 * k], rows[2 * k + 1], 0, 8, 1, 9, 4, 12, 5, 13);
+        b[k] = SHUFFLE(rows[2 * k], rows[2 * k + 1], 2, 10, 3, 11, 6, 14, 7, 15);
+    }
+    for (int k = 0; k < 2; k++) {
+        c[2 * k] = SHUFFLE(a[2 * k], a[2 * k + 1], 0, 1, 8, 9, 4, 5, 12, 13);
+        c[2 * k + 1] = SHUFFLE(a[2 * k], a[2 * k + 1], 2, 3, 10, 11, 6, 7, 14, 15);
+        d[2 * k] = SHUFFLE(b[2 * k], b[2 * k + 1], 0, 1, 8, 9, 4, 5, 12, 13);
+        d[2 * k + 1] = SHUFFLE(b[2 * k], b[2 * k + 1], 2, 3, 10, 11, 6, 7, 14, 15);
+    }
+    // c[0..1] / d[0..1]: lanes 0-3, c[2..3] / d[2..3]: lanes 4-7
+    rows[0] = SHUFFLE(c[0], c[2], 0, 1, 2, 3, 8, 9, 10, 11);
+    rows[4] = SHUFFLE(c[0], c[2], 4, 5, 6, 7, 12, 13, 14, 15);
+    rows[1] = SHUFFLE(c[1], c[3], 0, 1, 2, 3, 8, 9, 10, 11);
+    rows[5] = SHUFFLE(c[1], c[3], 4, 5, 6, 7, 12, 13, 14, 15);
+    rows[2] = SHUFFLE(d[0], d[2], 0, 1, 2, 3, 8, 9, 10, 11);
+    rows[6] = SHUFFLE(d[0], d[2], 4, 5, 6, 7, 12, 13, 14, 15);
+    rows[3] = SHUFFLE(d[1], d[3], 0, 1, 2, 3, 8, 9, 10, 11);
+    rows[7] = SHUFFLE(d[1], d[3], 4, 5, 6, 7, 12, 13, 14, 15);
+}
+
+HASH_MANY_DISPATCH
+static void hash_chunks(const uint8_t* input, uint64_t counter, uint32_t out[LANES][8]) {
+    const lanes_u32 zero = {};
+    lanes_u32 cv[8];
+    for (int i = 0; i < 8; i++) {
+        cv[i] = zero + IV[i];
+    }
+
+    lanes_u32 counter_lo, counter_hi;
+    for (size_t l = 0; l < LANES; l++) {
+        counter_lo[l] = static_cast<uint32_t>(counter + l);
+        counter_hi[l] = static_cast<uint32_t>((counter + l) >> 32);
+    }
+
+    for (size_t b = 0; b < 1024 / 64; b++) {
+        lanes_u32 m[16];
+        for (size_t l = 0; l < LANES; l++) {
+            std::memcpy(&m[l], input + l * 1024 + b * 64, 32);
+            std::memcpy(&m[l + 8], input + l * 1024 + b * 64 + 32, 32);
+        }
+        transpose(m);
+        transpose(m + 8);
+
+        uint32_t flags = (b == 0 ? uint32_t(CHUNK_START) : 0) | (b == 15 ? uint32_t(CHUNK_END) : 0);
+        lanes_u32 v[16] = {
+            cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+            zero + IV[0], zero + IV[1], zero + IV[2], zero + IV[3],
+            counter_lo, counter_hi, zero + 64u, zero + flags
+        };
+
+        ROUNDS(v, m);
+
+        for (int i = 0; i < 8; i++) {
+            cv[i] = v[i] ^ v[i + 8];
+        }
+    }
+
+    for (size_t l = 0; l < LANES; l++) {
+        for (int i = 0; i < 8; i++) {
+            out[l][i] = cv[i][l];
+        }
+    }
+}
+#endif
+
+Blake3::Blake3() {
+    reset();
+}
+
+void Blake3::reset() {
+    cv_stack_len_ = 0;
+    start_chunk(0);
+}
+
+void Blake3::start_chunk(uint64_t counter) {
+    std::memcpy(chunk_.cv, IV, sizeof(IV));
+    chunk_.counter = counter;
+    std::memset(chunk_.block, 0, sizeof(chunk_.block));
+    chunk_.block_len = 0;
+    chunk_.blocks_compressed = 0;
+}
+
+void Blake3::update_chunk(const uint8_t* input, size_t length) {
+    while (length > 0) {
+        // Only compress a full block once more input proves it is not the last
+        if (chunk_.block_len == BLOCK_LEN) {
+            uint32_t out[16];
+            uint32_t flags = chunk_.blocks_compressed == 0 ? uint32_t(CHUNK_START) : 0;
+            compress(chunk_.cv, chunk_.block, BLOCK_LEN, chunk_.counter, flags, out);
+            std::memcpy(chunk_.cv, out, sizeof(chunk_.cv));
+            chunk_.blocks_compressed++;
+            std::memset(chunk_.block, 0, sizeof(chunk_.block));
+            chunk_.block_len = 0;
+        }
+
+        size_t take = std::min(BLOCK_LEN - chunk_.block_len, length);
+        std::memcpy(chunk_.block + chunk_.block_len, input, take);
+        chunk_.block_len += static_cast<uint8_t>(take);
+        input += take;
+        length -= take;
+    }
+}
+
+void Blake3::push_chunk_cv(uint32_t cv[8], uint64_t total_chunks) {
+    // Merge completed subtrees: one parent per trailing zero bit of the count
+    uint8_t block[BLOCK_LEN];
+    while ((total_chunks & 1) == 0) {
+        cv_stack_len_--;
+        for (int i = 0; i < 8; i++) {
+            store32(block + 4 * i, cv_stack_[cv_stack_len_][i]);
+            store32(block + 32 + 4 * i, cv[i]);
+        }
+        uint32_t out[16];
+        compress(IV, block, BLOCK_LEN, 0, PARENT, out);
+        std::memcpy(cv, out, 8 * sizeof(uint32_t));
+        total_chunks >>= 1;
+    }
+
+    std::memcpy(cv_stack_[cv_stack_len_], cv, 8 * sizeof(uint32_t));
+    cv_stack_len_++;
+}
+
+void Blake3::update(const void* data, size_t length) {
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+
+    while (length > 0) {
+        if (chunk_.length() == CHUNK_LEN) {
+            uint32_t out[16];
+            uint32_t flags = (chunk_.blocks_compressed == 0 ? uint32_t(CHUNK_START) : 0) | CHUNK_END;
+            compress(chunk_.cv, chunk_.block, chunk_.block_len, chunk_.counter, flags, out);
+            uint64_t total_chunks = chunk_.counter + 1;
+            push_chunk_cv(out, total_chunks);
+            start_chunk(total_chunks);
+        }
+
+#ifdef BLAKE3_HASH_MANY
+        // Bulk path: whole chunks that are known not to be the final one
+        if (chunk_.length() == 0 && length > LANES * CHUNK_LEN) {
+            uint32_t cvs[LANES][8];
+            hash_chunks(input, chunk_.counter, cvs);
+            for (size_t l = 0; l < LANES; l++) {
+                push_chunk_cv(cvs[l], chunk_.counter + l + 1);
+            }
+            start_chunk(chunk_.counter + LANES);
+            input += LANES * CHUNK_LEN;
+            length -= LANES * CHUNK_LEN;
+            continue;
+        }
+#endif
+
+        size_t take = std::min(CHUNK_LEN - chunk_.length(), length);
+        update_chunk(input, take);
+        input += take;
+        length -= take;
+    }
+}
+
+void Blake3::finalize(uint8_t out[OUT_LEN]) const {
+    // Output node of the current chunk, then fold the stack from the right
+    uint32_t input_cv[8];
+    uint8_t block[BLOCK_LEN];
+    uint8_t block_len = chunk_.block_len;
+    uint32_t flags = (chunk_.blocks_compressed == 0 ? uint32_t(CHUNK_START) : 0) | CHUNK_END;
+    uint64_t counter = chunk_.counter;
+
+    std::memcpy(input_cv, chunk_.cv, sizeof(input_cv));
+    std::memcpy(block, chunk_.block, sizeof(block));
+
+    for (int n = cv_stack_len_ - 1; n >= 0; n--) {
+        uint32_t words[16];
+        compress(input_cv, block, block_len, counter, flags, words);
+        for (int i = 0; i < 8; i++) {
+            store32(block + 4 * i, cv_stack_[n][i]);
+            store32(block + 32 + 4 * i, words[i]);
+        }
+        std::memcpy(input_cv, IV, sizeof(IV));
+        block_len = BLOCK_LEN;
+        counter = 0;
+        flags = PARENT;
+    }
+
+    uint32_t words[16];
+    compress(input_cv, block, block_len, counter, flags | ROOT, words);
+    for (size_t i = 0; i < OUT_LEN / 4; i++) {
+        store32(out + 4 * i, words[i]);
+    }
+}
@@ -1,50 +1,365 @@
+// The SHA family deliberately stays on the low-level SHA*_Init/Update/Final
+// API, deprecated since OpenSSL 3.0: its contexts are plain structs that the
+// .part.hash sidecar can checkpoint, while EVP contexts are opaque and would
+// force a resume to rehash the whole prefix. Both end up in the same
+// runtime-dispatched kernels (SHA-NI, AVX2, ARMv8 crypto). The struct layout
+// is not part of OpenSSL's ABI promise, so sidecars record the library version.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
 #include "Checksum.h"
+#include "Blake3.h"
+#include "Crc32c.h"
+#include "Xxh3.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <openssl/crypto.h>
 #include <openssl/sha.h>
 #include <algorithm>
+#include <vector>
+#include <cstring>
 
-std::string Checksum::compute_sha256(const std::filesystem::path& file_path) {
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Hasher over a plain-data state
+template <typename State>
+class PodHasher : public Hasher {
+public:
+    size_t state_size() const override { return sizeof(State); }
+    const void* state() const override { return &state_; }
+    void restore(const void* state) override { std::memcpy(&state_, state, sizeof(State)); }
+
+protected:
+    State state_;
+};
+
+class Sha256Hasher : public PodHasher<SHA256_CTX> {
+public:
+    Sha256Hasher() { SHA256_Init(&state_); }
+
+    void update(const void* data, size_t length) override { SHA256_Update(&state_, data, length); }
+
+    std::string hex_digest() const override {
+        SHA256_CTX copy = state_;
+        unsigned char hash[SHA256_DIGEST_LENGTH];
+        SHA256_Final(hash, &copy);
+        return Checksum::bytes_to_hex(hash, sizeof(hash));
+    }
+};
+
+class Sha512Hasher : public PodHasher<SHA512_CTX> {
+public:
+    Sha512Hasher() { SHA512_Init(&state_); }
+
+    void update(const void* data, size_t length) override { SHA512_Update(&state_, data, length); }
+
+    std::string hex_digest() const override {
+        SHA512_CTX copy = state_;
+        unsigned char hash[SHA512_DIGEST_LENGTH];
+        SHA512_Final(hash, &copy);
+        return Checksum::bytes_to_hex(hash, sizeof(hash));
+    }
+};
+
+class Sha1Hasher : public PodHasher<SHA_CTX> {
+public:
+    Sha1Hasher() { SHA1_Init(&state_); }
+
+    void update(const void* data, size_t length) override { SHA1_Update(&state_, data, length); }
+
+    std::string hex_digest() const override {
+        SHA_CTX copy = state_;
+        unsigned char hash[SHA_DIGEST_LENGTH];
+        SHA1_Final(hash, &copy);
+        return Checksum::bytes_to_hex(hash, sizeof(hash));
+    }
+};
+
+class Blake3Hasher : public PodHasher<Blake3> {
+public:
+    void update(const void* data, size_t length) override { state_.update(data, length); }
+
+    std::string hex_digest() const override {
+        uint8_t hash[Blake3::OUT_LEN];
+        state_.finalize(hash);
+        return Checksum::bytes_to_hex(hash, sizeof(hash));
+    }
+};
+
+class Xxh3Hasher : public PodHasher<Xxh3> {
+public:
+    void update(const void* data, size_t length) override { state_.update(data, length); }
+
+    // Canonical (big-endian) form, as printed by xxhsum
+    std::string hex_digest() const override {
+        uint64_t value = state_.digest();
+        unsigned char hash[8];
+        for (int i = 0; i < 8; i++) {
+            hash[i] = static_cast<unsigned char>(value >> (56 - 8 * i));
+        }
+        return Checksum::bytes_to_hex(hash, sizeof(hash));
+    }
+};
+
+class Crc32cHasher : public PodHasher<uint32_t> {
+public:
+    Crc32cHasher() { state_ = 0; }
+
+    void update(const void* data, size_t length) override { state_ = Crc32c::update(state_, data, length); }
+
+    std::string hex_digest() const override {
+        unsigned char hash[4];
+        for (int i = 0; i < 4; i++) {
+            hash[i] = static_cast<unsigned char>(state_ >> (24 - 8 * i));
+        }
+        return Checksum::bytes_to_hex(hash, sizeof(hash));
+    }
+};
+
+struct AlgorithmInfo {
+    ChecksumAlgorithm algorithm;
+    const char* name;
+    size_t hex_length;
+};
+
+const AlgorithmInfo ALGORITHMS[] = {
+    {ChecksumAlgorithm::Sha256, "sha256", 64},
+    {ChecksumAlgorithm::Sha512, "sha512", 128},
+    {ChecksumAlgorithm::Sha1, "sha1", 40},
+    {ChecksumAlgorithm::Blake3, "blake3", 64},
+    {ChecksumAlgorithm::Xxh3, "xxh3", 16},
+    {ChecksumAlgorithm::Crc32c, "crc32c", 8},
+};
+
+const AlgorithmInfo& info(ChecksumAlgorithm algorithm) {
+    for (const auto& entry : ALGORITHMS) {
+        if (entry.algorithm == algorithm) {
+            return entry;
+        }
+    }
+    return ALGORITHMS[0];
+}
+
+// Hashing is mostly waiting for the disk: read in large windows and have the
+// kernel fetch the next one while the current one is being hashed
+const size_t READ_WINDOW = 16 * 1024 * 1024;
+
+#ifndef _WIN32
+void read_ahead(int fd, uint64_t offset, uint64_t length) {
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+#endif
+}
+
+// pread fallback for files that can't be mapped; the next window is
+// requested before the current one is read
+bool hash_fd_pread(int fd, uint64_t offset, uint64_t end, Hasher& hasher, uint64_t& hashed) {
+    std::vector<char> buffer(READ_WINDOW);
+
+    while (offset < end) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(READ_WINDOW, end - offset));
+        read_ahead(fd, offset + want, READ_WINDOW);
+
+        ssize_t got = pread(fd, buffer.data(), want, static_cast<off_t>(offset));
+        if (got < 0) {
+            return false;
+        }
+        if (got == 0) {
+            break;
+        }
+        hasher.update(buffer.data(), static_cast<size_t>(got));
+        offset += static_cast<uint64_t>(got);
+        hashed += static_cast<uint64_t>(got);
+    }
+    return true;
+}
+
+// Hash bytes [offset, end) of an open file, mapping it one window at a time
+bool hash_fd(int fd, uint64_t offset, uint64_t end, Hasher& hasher, uint64_t& hashed) {
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(end - offset), POSIX_FADV_SEQUENTIAL);
+#endif
+
+    while (offset < end) {
+        uint64_t map_start = offset - offset % page;
+        size_t map_length = static_cast<size_t>(std::min<uint64_t>(READ_WINDOW, end - map_start));
+        read_ahead(fd, map_start + map_length, READ_WINDOW);
+
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;  // fault the window in at once rather than page by page
+#endif
+        void* mapped = mmap(nullptr, map_length, PROT_READ, flags, fd, static_cast<off_t>(map_start));
+        if (mapped == MAP_FAILED) {
+            return hash_fd_pread(fd, offset, end, hasher, hashed);
+        }
+        madvise(mapped, map_length, MADV_SEQUENTIAL);
+
+        size_t skip = static_cast<size_t>(offset - map_start);
+        hasher.update(static_cast<const char*>(mapped) + skip, map_length - skip);
+        munmap(mapped, map_length);
+
+        hashed += map_length - skip;
+        offset = map_start + map_length;
+    }
+    return true;
+}
+#endif
+
+// Hash bytes [offset, end) of a file, end clamped to its size. Returns the
+// number of bytes hashed, or -1 if the file can't be read.
+int64_t hash_file(const std::filesystem::path& file_path, uint64_t offset, uint64_t end, Hasher& hasher) {
+    uint64_t hashed = 0;
+
+#ifndef _WIN32
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        if (S_ISREG(st.st_mode)) {
+            end = std::min<uint64_t>(end, static_cast<uint64_t>(st.st_size));
+            ok = offset >= end || hash_fd(fd, offset, end, hasher, hashed);
+        } else {
+            ok = hash_fd_pread(fd, offset, end, hasher, hashed);
+        }
+    }
+    close(fd);
+    return ok ? static_cast<int64_t>(hashed) : -1;
+#else
     std::ifstream file(file_path, std::ios::binary);
     if (!file.is_open()) {
-        std::cerr << "Error: Could not open file for checksum: " << file_path << std::endl;
+        return -1;
+    }
+    file.seekg(static_cast<std::streamoff>(offset));
+
+    std::vector<char> buffer(READ_WINDOW);
+    while (offset + hashed < end && file.good()) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(READ_WINDOW, end - offset - hashed));
+        file.read(buffer.data(), want);
+        size_t bytes_read = file.gcount();
+        if (bytes_read == 0) {
+            break;
+        }
+        hasher.update(buffer.data(), bytes_read);
+        hashed += bytes_read;
+    }
+    return static_cast<int64_t>(hashed);
+#endif
+}
+
+} // namespace
+
+std::unique_ptr<Hasher> Checksum::create_hasher(ChecksumAlgorithm algorithm) {
+    switch (algorithm) {
+    case ChecksumAlgorithm::Sha512:
+        return std::make_unique<Sha512Hasher>();
+    case ChecksumAlgorithm::Sha1:
+        return std::make_unique<Sha1Hasher>();
+    case ChecksumAlgorithm::Blake3:
+        return std::make_unique<Blake3Hasher>();
+    case ChecksumAlgorithm::Xxh3:
+        return std::make_unique<Xxh3Hasher>();
+    case ChecksumAlgorithm::Crc32c:
+        return std::make_unique<Crc32cHasher>();
+    case ChecksumAlgorithm::Sha256:
+    default:
+        return std::make_unique<Sha256Hasher>();
     }
+}
 
-    // Initialize SHA-256 context
-    SHA256_CTX sha256_ctx;
-    SHA256_Init(&sha256_ctx);
+bool Checksum::parse_algorithm(const std::string& name, ChecksumAlgorithm& algorithm) {
+    std::string lower = to_lowercase(name);
 
-    // Read file in chunks and update hash
-    const size_t BUFFER_SIZE = 1024 * 1024;  // 1 MB chunks
-    char buffer[BUFFER_SIZE];
+    // Common spellings of the same algorithms
+    if (lower == "sha-256") lower = "sha256";
+    else if (lower == "sha-512") lower = "sha512";
+    else if (lower == "sha-1") lower = "sha1";
+    else if (lower == "xxh3_64" || lower == "xxh3-64" || lower == "xxhash3" || lower == "xxhash") lower = "xxh3";
+    else if (lower == "crc-32c") lower = "crc32c";
 
-    while (file.good()) {
-        file.read(buffer, BUFFER_SIZE);
-        size_t bytes_read = file.gcount();
-        
-        if (bytes_read > 0) {
-            SHA256_Update(&sha256_ctx, buffer, bytes_read);
+    for (const auto& entry : ALGORITHMS) {
+        if (lower == entry.name) {
+            algorithm = entry.algorithm;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Checksum::parse_spec(const std::string& spec, ChecksumAlgorithm& algorithm, std::string& hex) {
+    size_t colon = spec.find(':');
+    if (colon != std::string::npos) {
+        hex = spec.substr(colon + 1);
+        return parse_algorithm(spec.substr(0, colon), algorithm);
+    }
+
+    // Bare digest: the length tells the algorithm apart, except 64 (SHA-256 wins)
+    hex = spec;
+    algorithm = ChecksumAlgorithm::Sha256;
+    for (const auto& entry : ALGORITHMS) {
+        if (entry.hex_length == spec.size() && entry.hex_length != 64) {
+            algorithm = entry.algorithm;
         }
     }
+    return true;
+}
+
+std::string Checksum::algorithm_name(ChecksumAlgorithm algorithm) {
+    return info(algorithm).name;
+}
+
+size_t Checksum::digest_hex_length(ChecksumAlgorithm algorithm) {
+    return info(algorithm).hex_length;
+}
+
+std::string Checksum::compute(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm) {
+    std::unique_ptr<Hasher> hasher = create_hasher(algorithm);
+
+    if (hash_file(file_path, 0, UINT64_MAX, *hasher) < 0) {
+        std::cerr << "Error: Could not read file for checksum: " << file_path << std::endl;
+        return "";
+    }
+
+    return hasher->hex_digest();
+}
+
+std::string Checksum::compute_range(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm,
+                                    uint64_t offset, uint64_t length) {
+    std::unique_ptr<Hasher> hasher = create_hasher(algorithm);
 
-    file.close();
+    if (hash_file(file_path, offset, offset + length, *hasher) != static_cast<int64_t>(length)) {
+        return "";
+    }
 
-    unsigned char hash[SHA256_DIGEST_LENGTH];  // 32 bytes
-    SHA256_Final(hash, &sha256_ctx);
+    return hasher->hex_digest();
+}
 
-     return bytes_to_hex(hash, SHA256_DIGEST_LENGTH);
+std::string Checksum::compute_sha256(const std::filesystem::path& file_path) {
+    return compute(file_path, ChecksumAlgorithm::Sha256);
 }
 
 std::string Checksum::bytes_to_hex(const unsigned char* data, size_t length) {
     std::stringstream ss;
     ss << std::hex << std::setfill('0');
-    
+
     for (size_t i = 0; i < length; i++) {
         ss << std::setw(2) << static_cast<int>(data[i]);
     }
-    
+
     return ss.str();
 }
 
@@ -55,22 +370,124 @@ std::string Checksum::to_lowercase(const std::string& str) {
     return result;
 }
 
-bool Checksum::verify_sha256(const std::filesystem::path& file_path, 
-                              const std::string& expected_hash) {
+bool Checksum::verify(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm,
+                      const std::string& expected_hash) {
     // Compute actual hash
-    std::string actual_hash = compute_sha256(file_path);
-    
+    std::string actual_hash = compute(file_path, algorithm);
+
     if (actual_hash.empty()) {
         return false;  // Failed to compute hash
     }
-    
+
     // Compare case-insensitively
-    std::string actual_lower = to_lowercase(actual_hash);
-    std::string expected_lower = to_lowercase(expected_hash);
-    
-    return actual_lower == expected_lower;
+    return to_lowercase(actual_hash) == to_lowercase(expected_hash);
 }
 
+bool Checksum::verify_sha256(const std::filesystem::path& file_path,
+                              const std::string& expected_hash) {
+    return verify(file_path, ChecksumAlgorithm::Sha256, expected_hash);
+}
+
+ChecksumStream::ChecksumStream(ChecksumAlgorithm algorithm)
+    : algorithm_(algorithm)
+{
+    reset();
+}
+
+void ChecksumStream::reset() {
+    hasher_ = Checksum::create_hasher(algorithm_);
+    bytes_ = 0;
+}
+
+void ChecksumStream::reset(ChecksumAlgorithm algorithm) {
+    algorithm_ = algorithm;
+    reset();
+}
+
+void ChecksumStream::update(const void* data, size_t length) {
+    hasher_->update(data, length);
+    bytes_ += length;
+}
+
+bool ChecksumStream::update_from_file(const std::filesystem::path& file_path, uint64_t up_to) {
+    int64_t hashed = hash_file(file_path, bytes_, up_to, *hasher_);
+    if (hashed < 0) {
+        std::cerr << "Error: Could not read file for checksum: " << file_path << std::endl;
+        return false;
+    }
+
+    bytes_ += static_cast<uint64_t>(hashed);
+    return bytes_ == up_to;
+}
+
+std::string ChecksumStream::hex_digest() const {
+    return hasher_->hex_digest();
+}
 
+// Sidecar layout: magic, OpenSSL version, algorithm, state size, bytes covered, raw state
+static const char STATE_MAGIC[8] = {'C', 'K', 'S', 'T', 'A', 'T', 'E', '3'};
 
+bool ChecksumStream::save_state(const std::filesystem::path& state_path) const {
+    std::filesystem::path tmp_path = state_path;
+    tmp_path += ".tmp";
 
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        uint64_t library = static_cast<uint64_t>(OpenSSL_version_num());
+        uint32_t algorithm = static_cast<uint32_t>(algorithm_);
+        uint32_t state_size = static_cast<uint32_t>(hasher_->state_size());
+        out.write(STATE_MAGIC, sizeof(STATE_MAGIC));
+        out.write(reinterpret_cast<const char*>(&library), sizeof(library));
+        out.write(reinterpret_cast<const char*>(&algorithm), sizeof(algorithm));
+        out.write(reinterpret_cast<const char*>(&state_size), sizeof(state_size));
+        out.write(reinterpret_cast<const char*>(&bytes_), sizeof(bytes_));
+        out.write(static_cast<const char*>(hasher_->state()), state_size);
+        if (!out.good()) {
+            return false;
+        }
+    }
+
+    // Replace atomically so a crash never leaves a torn state behind
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, state_path, ec);
+    return !ec;
+}
+
+bool ChecksumStream::load_state(const std::filesystem::path& state_path) {
+    std::ifstream in(state_path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    char magic[sizeof(STATE_MAGIC)];
+    uint64_t library = 0;
+    uint32_t algorithm = 0;
+    uint32_t state_size = 0;
+    uint64_t bytes = 0;
+
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&library), sizeof(library));
+    in.read(reinterpret_cast<char*>(&algorithm), sizeof(algorithm));
+    in.read(reinterpret_cast<char*>(&state_size), sizeof(state_size));
+    in.read(reinterpret_cast<char*>(&bytes), sizeof(bytes));
+    // An OpenSSL upgrade may change the SHA context layout: rehash instead
+    if (!in.good() || std::memcmp(magic, STATE_MAGIC, sizeof(magic)) != 0 ||
+        library != static_cast<uint64_t>(OpenSSL_version_num()) ||
+        algorithm != static_cast<uint32_t>(algorithm_) || state_size != hasher_->state_size()) {
+        return false;
+    }
+
+    std::vector<char> state(state_size);
+    in.read(state.data(), state_size);
+    if (!in.good()) {
+        return false;
+    }
+
+    hasher_->restore(state.data());
+    bytes_ = bytes;
+    return true;
+}
@@ -0,0 +1,197 @@
+#include "ChunkManifest.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+bool hex_to_bytes(const std::string& hex, std::string& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+
+    bytes.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int value = 0;
+        for (size_t j = i; j < i + 2; ++j) {
+            char c = hex[j];
+            int nibble = (c >= '0' && c <= '9') ? c - '0'
+                       : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                       : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (nibble < 0) {
+                return false;
+            }
+            value = value * 16 + nibble;
+        }
+        bytes.push_back(static_cast<char>(value));
+    }
+    return true;
+}
+
+} // namespace
+
+ChunkManifest::ChunkManifest()
+    : algorithm_(ChecksumAlgorithm::Sha256)
+    , chunk_size_(DEFAULT_CHUNK_SIZE)
+    , size_(0)
+{
+}
+
+uint64_t ChunkManifest::chunk_length(size_t index) const {
+    uint64_t offset = chunk_offset(index);
+    return offset >= size_ ? 0 : std::min(chunk_size_, size_ - offset);
+}
+
+bool ChunkManifest::matches(size_t index, const std::string& hex) const {
+    return index < digests_.size() && !hex.empty() && Checksum::to_lowercase(hex) == digests_[index];
+}
+
+bool ChunkManifest::verify_chunk(const std::filesystem::path& file_path, size_t index) const {
+    return matches(index, Checksum::compute_range(file_path, algorithm_, chunk_offset(index), chunk_length(index)));
+}
+
+std::string ChunkManifest::merkle_root(ChecksumAlgorithm algorithm, const std::vector<std::string>& digests) {
+    if (digests.empty()) {
+        return Checksum::create_hasher(algorithm)->hex_digest();
+    }
+
+    std::vector<std::string> level = digests;
+    while (level.size() > 1) {
+        std::vector<std::string> parents;
+        for (size_t i = 0; i < level.size(); i += 2) {
+            if (i + 1 == level.size()) {
+                parents.push_back(level[i]);
+                continue;
+            }
+
+            std::string left;
+            std::string right;
+            if (!hex_to_bytes(level[i], left) || !hex_to_bytes(level[i + 1], right)) {
+                return "";
+            }
+            std::unique_ptr<Hasher> hasher = Checksum::create_hasher(algorithm);
+            hasher->update(left.data(), left.size());
+            hasher->update(right.data(), right.size());
+            parents.push_back(hasher->hex_digest());
+        }
+        level.swap(parents);
+    }
+    return level.front();
+}
+
+bool ChunkManifest::load(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open chunk manifest: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    std::getline(file, line);
+    if (line != "chunkhash 1") {
+        std::cerr << "Error: not a chunk manifest: " << path << std::endl;
+        return false;
+    }
+
+    std::string algorithm_name;
+    std::vector<std::string> digests;
+    std::string root;
+    uint64_t chunk_size = 0;
+    uint64_t size = 0;
+
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "algorithm") {
+            fields >> algorithm_name;
+        } else if (key == "chunk_size") {
+            fields >> chunk_size;
+        } else if (key == "size") {
+            fields >> size;
+        } else if (key == "root") {
+            fields >> root;
+        } else {
+            digests.push_back(Checksum::to_lowercase(key));
+        }
+    }
+
+    ChecksumAlgorithm algorithm;
+    if (!Checksum::parse_algorithm(algorithm_name, algorithm) || chunk_size == 0) {
+        std::cerr << "Error: chunk manifest has no valid algorithm or chunk size: " << path << std::endl;
+        return false;
+    }
+
+    uint64_t expected_chunks = (size + chunk_size - 1) / chunk_size;
+    size_t hex_length = Checksum::digest_hex_length(algorithm);
+    bool well_formed = digests.size() == expected_chunks &&
+        std::all_of(digests.begin(), digests.end(), [hex_length](const std::string& hex) {
+            return hex.size() == hex_length;
+        });
+
+    // The root covers every chunk digest, a damaged or truncated list won't reproduce it
+    if (!well_formed || merkle_root(algorithm, digests) != Checksum::to_lowercase(root)) {
+        std::cerr << "Error: chunk manifest does not match its root: " << path << std::endl;
+        return false;
+    }
+
+    algorithm_ = algorithm;
+    chunk_size_ = chunk_size;
+    size_ = size;
+    root_ = Checksum::to_lowercase(root);
+    digests_.swap(digests);
+    return true;
+}
+
+bool ChunkManifest::save(const std::filesystem::path& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not write chunk manifest: " << path << std::endl;
+        return false;
+    }
+
+    file << "chunkhash 1\n"
+         << "algorithm " << Checksum::algorithm_name(algorithm_) << "\n"
+         << "chunk_size " << chunk_size_ << "\n"
+         << "size " << size_ << "\n"
+         << "root " << root_ << "\n";
+    for (const auto& digest : digests_) {
+        file << digest << "\n";
+    }
+    return file.good();
+}
+
+bool ChunkManifest::build(const std::filesystem::path& file_path, ChecksumAlgorithm algorithm, uint64_t chunk_size) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(file_path, ec);
+    if (ec || chunk_size == 0) {
+        std::cerr << "Error: could not read " << file_path << std::endl;
+        return false;
+    }
+
+    algorithm_ = algorithm;
+    chunk_size_ = chunk_size;
+    size_ = size;
+    digests_.clear();
+
+    for (size_t i = 0; chunk_offset(i) < size_; ++i) {
+        std::string digest = Checksum::compute_range(file_path, algorithm_, chunk_offset(i), chunk_length(i));
+        if (digest.empty()) {
+            std::cerr << "Error: could not read " << file_path << std::endl;
+            digests_.clear();
+            return false;
+        }
+        digests_.push_back(digest);
+    }
+
+    root_ = merkle_root(algorithm_, digests_);
+    return true;
+}
@@ -0,0 +1,136 @@
+#include "ConcurrencyController.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+std::string rate(double bytesPerSecond) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << bytesPerSecond / (1024 * 1024) << " MB/s";
+    return out.str();
+}
+
+std::string percent(double ratio) {
+    std::ostringstream out;
+    out << std::showpos << std::fixed << std::setprecision(0) << (ratio - 1.0) * 100 << "%";
+    return out.str();
+}
+
+} // namespace
+
+ConcurrencyController::ConcurrencyController(size_t initial, size_t minimum, size_t maximum)
+    : limit_(initial)
+    , minimum_(std::max<size_t>(minimum, 1))
+    , maximum_(std::max(maximum, minimum_))
+    , errors_(0)
+    , latencySum_(0)
+    , latencyCount_(0)
+    , lastAction_(Action::Hold)
+    , lastGoodput_(0)
+    , lastPerStream_(0)
+    , baselineLatency_(0)
+    , cooldown_(0)
+{
+    limit_.store(std::min(std::max(initial, minimum_), maximum_));
+}
+
+void ConcurrencyController::recordError() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    errors_++;
+}
+
+void ConcurrencyController::recordLatency(double seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencySum_ += seconds;
+    latencyCount_++;
+}
+
+ConcurrencyController::Decision ConcurrencyController::decrease(size_t limit, const std::string& why, int cooldown) {
+    size_t lowered = std::max(minimum_, std::min(limit - 1, static_cast<size_t>(std::floor(limit * DECREASE_FACTOR))));
+    cooldown_ = cooldown;
+    lastAction_ = Action::Decrease;
+    if (lowered == limit) {
+        return Decision{limit, false, why + ", already at minimum " + std::to_string(limit)};
+    }
+    limit_.store(lowered);
+    return Decision{lowered, true, why + ": " + std::to_string(limit) + " -> " + std::to_string(lowered)};
+}
+
+ConcurrencyController::Decision ConcurrencyController::update(const Sample& sample) {
+    size_t errors = 0;
+    double latency = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        errors = errors_;
+        if (latencyCount_ > 0) {
+            latency = latencySum_ / latencyCount_;
+        }
+        errors_ = 0;
+        latencySum_ = 0;
+        latencyCount_ = 0;
+    }
+
+    size_t limit = limit_.load();
+    double perStream = sample.active > 0 ? sample.goodput / sample.active : 0;
+    Action previous = lastAction_;
+    double previousGoodput = lastGoodput_;
+    double previousPerStream = lastPerStream_;
+    lastGoodput_ = sample.goodput;
+    lastPerStream_ = perStream;
+
+    //Latency baseline: the lowest seen, drifting up slowly so a slower phase can become normal
+    bool slow = false;
+    double baseline = baselineLatency_;
+    if (latency > 0) {
+        slow = baseline > 0 && latency > baseline * LATENCY_FACTOR;
+        baselineLatency_ = baselineLatency_ == 0 || latency < baselineLatency_
+            ? latency : baselineLatency_ + (latency - baselineLatency_) * 0.05;
+    }
+
+    if (errors > 0) {
+        return decrease(limit, std::to_string(errors) + " errors/retries in the last interval", 2);
+    }
+
+    if (slow) {
+        std::ostringstream why;
+        why << "time to first byte " << static_cast<int>(latency * 1000) << " ms, baseline "
+            << static_cast<int>(baseline * 1000) << " ms";
+        return decrease(limit, why.str(), 2);
+    }
+
+    //The last slot bought nothing: goodput flat while every stream got slower
+    if (previous == Action::Increase && previousGoodput > 0 &&
+        sample.goodput < previousGoodput * (1 + MIN_GAIN) && perStream < previousPerStream) {
+        size_t lowered = std::max(minimum_, limit - 1);
+        limit_.store(lowered);
+        lastAction_ = Action::Decrease;
+        cooldown_ = 3;
+        return Decision{lowered, lowered != limit, "goodput " + percent(sample.goodput / previousGoodput) +
+                        " but per-stream " + percent(perStream / previousPerStream) + " after the last increase: " +
+                        std::to_string(limit) + " -> " + std::to_string(lowered)};
+    }
+
+    lastAction_ = Action::Hold;
+    if (cooldown_ > 0) {
+        cooldown_--;
+        return Decision{limit, false, "cooling down after a decrease"};
+    }
+
+    if (sample.queued == 0 || sample.active < limit) {
+        return Decision{limit, false, "not saturated (" + std::to_string(sample.active) + " active, " +
+                        std::to_string(sample.queued) + " queued)"};
+    }
+
+    if (limit >= maximum_) {
+        return Decision{limit, false, "at maximum " + std::to_string(limit)};
+    }
+
+    limit_.store(limit + 1);
+    lastAction_ = Action::Increase;
+    std::string why = previousGoodput > 0 && previous == Action::Increase
+        ? "goodput " + percent(sample.goodput / previousGoodput) + " to " + rate(sample.goodput)
+        : "probing at " + rate(sample.goodput);
+    return Decision{limit + 1, true, why + ": " + std::to_string(limit) + " -> " + std::to_string(limit + 1)};
+}
@@ -74,6 +74,54 @@ Config ConfigManager::load_config() {
         if (j.contains("default_download_dir")) {
             config.default_download_dir = j["default_download_dir"].get<std::string>();
         }
+        //The CLI rejects anything below 1: 0 would never start a task, a negative value no limit at all
+        Config defaults;
+        if (j.contains("segments")) {
+            config.segments = j["segments"];
+            if (config.segments < 1) {
+                std::cerr << "Ignoring segments below 1 in config file" << std::endl;
+                config.segments = defaults.segments;
+            }
+        }
+        if (j.contains("max_concurrent")) {
+            config.max_concurrent = j["max_concurrent"];
+            if (config.max_concurrent < 1) {
+                std::cerr << "Ignoring max_concurrent below 1 in config file" << std::endl;
+                config.max_concurrent = defaults.max_concurrent;
+            }
+        }
+        //0 turns these off; the CLI rejects anything below, so a negative value here does the same
+        if (j.contains("adaptive_max_concurrent")) {
+            config.adaptive_max_concurrent = j["adaptive_max_concurrent"];
+            if (config.adaptive_max_concurrent < 0) {
+                std::cerr << "Ignoring negative adaptive_max_concurrent in config file" << std::endl;
+                config.adaptive_max_concurrent = 0;
+            }
+        }
+        if (j.contains("max_per_host")) {
+            config.max_per_host = j["max_per_host"];
+            if (config.max_per_host < 0) {
+                std::cerr << "Ignoring negative max_per_host in config file" << std::endl;
+                config.max_per_host = 0;
+            }
+        }
+        //Like parse_size on the CLI: a signed value would wrap and silently lift the cap
+        if (j.contains("max_bytes_per_second")) {
+            if (j["max_bytes_per_second"].is_number_unsigned()) {
+                config.max_bytes_per_second = j["max_bytes_per_second"];
+            } else {
+                std::cerr << "Ignoring invalid max_bytes_per_second in config file" << std::endl;
+                config.max_bytes_per_second = 0;
+            }
+        }
+        if (j.contains("burst_bytes")) {
+            if (j["burst_bytes"].is_number_unsigned()) {
+                config.burst_bytes = j["burst_bytes"];
+            } else {
+                std::cerr << "Ignoring invalid burst_bytes in config file" << std::endl;
+                config.burst_bytes = 0;
+            }
+        }
         
         std::cout << "Loaded config from: " << config_path << std::endl;
 
@@ -97,6 +145,12 @@ void ConfigManager::save_config(const Config& config) {
         j["timeout_seconds"] = config.timeout_seconds;
         j["connect_timeout_seconds"] = config.connect_timeout_seconds;
         j["default_download_dir"] = config.default_download_dir;
+        j["segments"] = config.segments;
+        j["max_concurrent"] = config.max_concurrent;
+        j["adaptive_max_concurrent"] = config.adaptive_max_concurrent;
+        j["max_per_host"] = config.max_per_host;
+        j["max_bytes_per_second"] = config.max_bytes_per_second;
+        j["burst_bytes"] = config.burst_bytes;
 
         std::ofstream file(config_path);
         if (!file.is_open()) {
@@ -143,11 +197,44 @@ Config ConfigManager::merge_configs(const Config& file_config, const Config& cli
         merged.connect_timeout_seconds = cli_config.connect_timeout_seconds;
     }
 
+    if (cli_config.segments != defaults.segments) {
+        merged.segments = cli_config.segments;
+    }
+
+    if (cli_config.max_concurrent != defaults.max_concurrent) {
+        merged.max_concurrent = cli_config.max_concurrent;
+    }
+
+    if (cli_config.adaptive_max_concurrent != defaults.adaptive_max_concurrent) {
+        merged.adaptive_max_concurrent = cli_config.adaptive_max_concurrent;
+    }
+
+    if (cli_config.max_per_host != defaults.max_per_host) {
+        merged.max_per_host = cli_config.max_per_host;
+    }
+
+    if (cli_config.max_bytes_per_second != defaults.max_bytes_per_second) {
+        merged.max_bytes_per_second = cli_config.max_bytes_per_second;
+    }
+
+    if (cli_config.burst_bytes != defaults.burst_bytes) {
+        merged.burst_bytes = cli_config.burst_bytes;
+    }
+
     merged.url = cli_config.url;
+    merged.input_file = cli_config.input_file;
     merged.output_path = cli_config.output_path;
     merged.show_help = cli_config.show_help;
     merged.verify_checksum = cli_config.verify_checksum;
     merged.expected_checksum = cli_config.expected_checksum;
+    merged.checksum_algorithm = cli_config.checksum_algorithm;
+    merged.verify_manifest = cli_config.verify_manifest;
+    merged.manifest_algorithm = cli_config.manifest_algorithm;
+    merged.chunk_manifest = cli_config.chunk_manifest;
+    merged.make_chunk_manifest = cli_config.make_chunk_manifest;
+    merged.chunk_size = cli_config.chunk_size;
+    merged.events = cli_config.events;
+    merged.group_weights = cli_config.group_weights;
 
     //If output_path is empty but default_download_dir is set, use it
     if (merged.output_path.empty() && !merged.default_download_dir.empty()) {
@@ -0,0 +1,91 @@
+#include "Crc32c.h"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+static const uint32_t POLY = 0x82F63B78; // reflected Castagnoli polynomial
+
+struct Crc32cTable {
+    uint32_t entries[256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+static uint32_t update_table(uint32_t crc, const uint8_t* data, size_t length) {
+    static const Crc32cTable table;
+    for (size_t i = 0; i < length; i++) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t update_hw(uint32_t crc, const uint8_t* data, size_t length) {
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (length > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        length--;
+    }
+    return crc;
+}
+
+static bool has_hw() {
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t update_hw(uint32_t crc, const uint8_t* data, size_t length) {
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        crc = __crc32cb(crc, *data++);
+        length--;
+    }
+    return crc;
+}
+
+static bool has_hw() {
+    return true;
+}
+#else
+static uint32_t update_hw(uint32_t crc, const uint8_t* data, size_t length) {
+    return update_table(crc, data, length);
+}
+
+static bool has_hw() {
+    return false;
+}
+#endif
+
+uint32_t Crc32c::update(uint32_t crc, const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    crc = has_hw() ? update_hw(crc, bytes, length) : update_table(crc, bytes, length);
+    return ~crc;
+}
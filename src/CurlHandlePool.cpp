@@ -0,0 +1,129 @@
+#include "CurlHandlePool.h"
+#include "Logger.h"
+#include "Url.h"
+
+CurlHandlePool::CurlHandlePool() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+CurlHandlePool::~CurlHandlePool() {
+    //Runs at exit: free idle handles, then the shares they were attached to
+    for (auto& entry : lanes_) {
+        Lane* lane = entry.second.get();
+        for (auto& idle : lane->idle) {
+            for (CURL* handle : idle.second) {
+                curl_easy_cleanup(handle);
+            }
+        }
+        if (lane->share) {
+            curl_share_cleanup(lane->share);
+        }
+    }
+}
+
+CurlHandlePool& CurlHandlePool::getInstance() {
+    static CurlHandlePool instance;
+    return instance;
+}
+
+void CurlHandlePool::lockShare(CURL* /*handle*/, curl_lock_data data, curl_lock_access /*access*/, void* userptr) {
+    Lane* lane = static_cast<Lane*>(userptr);
+    lane->locks[data].lock();
+}
+
+void CurlHandlePool::unlockShare(CURL* /*handle*/, curl_lock_data data, void* userptr) {
+    Lane* lane = static_cast<Lane*>(userptr);
+    lane->locks[data].unlock();
+}
+
+CurlHandlePool::Lane* CurlHandlePool::laneForThisThread() {
+    auto& lane = lanes_[std::this_thread::get_id()];
+    if (lane) {
+        return lane.get();
+    }
+
+    lane = std::make_unique<Lane>();
+    lane->idleCount = 0;
+    lane->share = curl_share_init();
+
+    if (lane->share) {
+        curl_share_setopt(lane->share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(lane->share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(lane->share, CURLSHOPT_USERDATA, lane.get());
+        curl_share_setopt(lane->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(lane->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(lane->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    } else {
+        LOG_WARN("Could not create curl share, connections will not be reused across files");
+    }
+
+    return lane.get();
+}
+
+CURL* CurlHandlePool::acquire(const std::string& url) {
+    std::string host = hostFromUrl(url);
+    CURL* handle = nullptr;
+    Lane* lane = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lane = laneForThisThread();
+
+        //Same host first, then any idle handle of this lane
+        auto it = lane->idle.find(host);
+        if (it == lane->idle.end() || it->second.empty()) {
+            it = lane->idle.begin();
+            while (it != lane->idle.end() && it->second.empty()) {
+                ++it;
+            }
+        }
+
+        if (it != lane->idle.end()) {
+            handle = it->second.back();
+            it->second.pop_back();
+            lane->idleCount--;
+        }
+    }
+
+    if (handle) {
+        //Clears options only, connections and caches stay warm
+        curl_easy_reset(handle);
+    } else {
+        handle = curl_easy_init();
+        if (!handle) {
+            return nullptr;
+        }
+    }
+
+    if (lane->share) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, lane->share);
+    }
+    curl_easy_setopt(handle, CURLOPT_MAXCONNECTS, MAX_CACHED_CONNECTIONS);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    owners_[handle] = Owner{lane, host};
+    return handle;
+}
+
+void CurlHandlePool::release(CURL* handle) {
+    if (!handle) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = owners_.find(handle);
+        if (it != owners_.end()) {
+            Owner owner = it->second;
+            owners_.erase(it);
+
+            if (owner.lane->idleCount < MAX_IDLE_PER_LANE) {
+                owner.lane->idle[owner.host].push_back(handle);
+                owner.lane->idleCount++;
+                return;
+            }
+        }
+    }
+
+    curl_easy_cleanup(handle);
+}
@@ -9,12 +9,41 @@
 #include "ThreadPool.h"
 #include "DownloadTask.h"
 #include <chrono>
+#include <fstream>
+#include <sstream>
 #include <DownloadManagerClass.h>
+#include "ManifestVerifier.h"
+#include "ChunkManifest.h"
+#include "ProgressDashboard.h"
+#include "BandwidthLimiter.h"
+#include "ConcurrencyController.h"
+#include "RunQueue.h"
+#include "Url.h"
+#include "EventStream.h"
+#include <iomanip>
+#include <cmath>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
+int run_batch(const Config& config);
+int run_verify_manifest(const Config& config);
+int run_make_chunk_manifest(const Config& config);
 void test_download_manager();
 void test_thread_pool();
 void test_download_task();
 void test_pause_resume();
+void test_chunk_repair();
+void test_event_stream();
+void test_progress_aggregator();
+void test_bandwidth_limiter();
+void test_concurrency_controller();
+void test_run_queue();
+void test_task_counts();
+void test_task_handles();
+void test_pause_barrier();
+void test_manifest_verifier();
 
 int main(int argc, char* argv[]) {
     //TestThreadPool
@@ -38,6 +67,56 @@ int main(int argc, char* argv[]) {
     test_pause_resume();
     return 0;
 }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-chunkrepair") {
+        test_chunk_repair();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-eventstream") {
+        test_event_stream();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-progress") {
+        test_progress_aggregator();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-bandwidth") {
+        test_bandwidth_limiter();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-concurrency") {
+        test_concurrency_controller();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-runqueue") {
+        test_run_queue();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-taskcounts") {
+        test_task_counts();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-taskhandles") {
+        test_task_handles();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-pausebarrier") {
+        test_pause_barrier();
+        return 0;
+    }
+
+    if (argc == 2 && std::string(argv[1]) == "--test-manifest") {
+        test_manifest_verifier();
+        return 0;
+    }
     //TestEnd
     
     Config config = ArgParser::parse(argc, argv);
@@ -46,6 +125,21 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    //One bucket for every transfer of this process
+    BandwidthLimiter::getInstance().setRate(config.max_bytes_per_second, config.burst_bytes);
+
+    if (!config.input_file.empty()) {
+        return run_batch(config);
+    }
+
+    if (!config.verify_manifest.empty()) {
+        return run_verify_manifest(config);
+    }
+
+    if (!config.make_chunk_manifest.empty()) {
+        return run_make_chunk_manifest(config);
+    }
+
     // Create HTTP client and start download
     CurlHttpClient httpClient;
     
@@ -56,9 +150,17 @@ int main(int argc, char* argv[]) {
     std::cout << "Retry count: " << config.retry_count << std::endl;
     std::cout << "Timeout: " << config.timeout_seconds << "s" << std::endl;
 
+    if (config.max_bytes_per_second > 0) {
+        std::cout << "Rate limit: " << CurlHttpClient::format_bytes(static_cast<curl_off_t>(config.max_bytes_per_second)) << "/s" << std::endl;
+    }
+
     if (config.verify_checksum) {
         std::cout << "Checksum verification: enabled" << std::endl;
-        std::cout << "Expected hash: " << config.expected_checksum.substr(0, 16) << "..." << std::endl;
+        std::cout << "Expected hash: " << config.checksum_algorithm << ":" << config.expected_checksum.substr(0, 16) << "..." << std::endl;
+    }
+
+    if (!config.chunk_manifest.empty()) {
+        std::cout << "Chunk verification: " << config.chunk_manifest << std::endl;
     }
 
         // Internal logging
@@ -78,6 +180,169 @@ int main(int argc, char* argv[]) {
     return success ? 0 : 1;
 }
 
+int run_batch(const Config& config) {
+    std::ifstream input(config.input_file);
+    if (!input.is_open()) {
+        std::cerr << "Error: could not open input file: " << config.input_file << std::endl;
+        return 1;
+    }
+
+    DownloadManager manager(static_cast<size_t>(config.max_concurrent));
+
+    EventStream events;
+    if (!config.events.empty()) {
+        if (!events.open(config.events)) {
+            return 1;
+        }
+        events.setProgressSource([&manager] { return manager.getProgress(); });
+        manager.setEventStream(&events);
+    }
+
+    for (const auto& group : config.group_weights) {
+        manager.setGroupWeight(group.first, group.second);
+    }
+
+    // One "URL [output] [weight=w] [limit=n[K|M|G]] [group=name]" per line,
+    // blank lines and # comments are skipped
+    std::string line;
+    while (std::getline(input, line)) {
+        std::istringstream fields(line);
+        std::string url;
+        std::string output;
+        double weight = 1.0;
+        uint64_t limit = 0;
+        std::string group;
+        bool valid_options = true;
+        fields >> url;
+
+        std::string field;
+        while (fields >> field) {
+            if (field.compare(0, 7, "weight=") == 0) {
+                try {
+                    weight = std::stod(field.substr(7));
+                } catch (const std::exception& e) {
+                    weight = 0;
+                }
+                valid_options = valid_options && weight > 0;
+            } else if (field.compare(0, 6, "limit=") == 0) {
+                valid_options = valid_options && ArgParser::parse_size(field.substr(6), limit);
+            } else if (field.compare(0, 6, "group=") == 0) {
+                group = field.substr(6);
+            } else if (output.empty()) {
+                output = field;
+            }
+        }
+
+        if (url.empty() || url[0] == '#') {
+            continue;
+        }
+
+        if (!ArgParser::is_valid_url(url)) {
+            std::cerr << "Skipping invalid URL: " << url << std::endl;
+            continue;
+        }
+
+        if (!valid_options) {
+            std::cerr << "Skipping line with invalid weight or limit: " << url << std::endl;
+            continue;
+        }
+
+        if (output.empty()) {
+            size_t last_slash = url.find_last_of('/');
+            std::string filename = "download.bin";
+            if (last_slash != std::string::npos && last_slash < url.length() - 1) {
+                filename = url.substr(last_slash + 1);
+            }
+            output = config.default_download_dir + "/" + filename;
+        }
+
+        manager.addDownload(url, output, config.retry_count, config.timeout_seconds, "", config.segments,
+                            weight, limit, group);
+    }
+
+    if (config.adaptive_max_concurrent > 0) {
+        manager.setAdaptiveConcurrency(1, static_cast<size_t>(config.adaptive_max_concurrent));
+    }
+    if (config.max_per_host > 0) {
+        manager.setMaxPerHost(static_cast<size_t>(config.max_per_host));
+    }
+
+    std::cout << "Downloading " << manager.getTotalCount() << " files ("
+              << manager.getMaxConcurrent() << " concurrent";
+    if (config.adaptive_max_concurrent > 0) {
+        std::cout << ", adaptive up to " << config.adaptive_max_concurrent;
+    }
+    if (config.max_per_host > 0) {
+        std::cout << ", " << config.max_per_host << " per host";
+    }
+    if (config.max_bytes_per_second > 0) {
+        std::cout << ", " << CurlHttpClient::format_bytes(static_cast<curl_off_t>(config.max_bytes_per_second)) << "/s total";
+    }
+    std::cout << ")" << std::endl;
+
+    //One renderer thread draws every task; piped output gets only the summary.
+    //It captures std::cout before any worker runs and lets go only once they are idle.
+    ProgressDashboard dashboard(manager);
+    bool show_dashboard = ProgressDashboard::isTerminal() && !events.usesFd(1);
+
+    if (show_dashboard) {
+        dashboard.start();
+    }
+    manager.start();
+    manager.waitForCompletion();
+    if (show_dashboard) {
+        dashboard.stop();
+    }
+    events.close();
+
+    size_t failed = manager.getTotalCount() - manager.getStateCount(DownloadState::Completed);
+
+    std::cout << "Completed: " << (manager.getTotalCount() - failed)
+              << " Failed: " << failed << std::endl;
+
+    return failed == 0 ? 0 : 1;
+}
+
+int run_verify_manifest(const Config& config) {
+    ManifestVerifier verifier(static_cast<size_t>(config.max_concurrent));
+    if (!verifier.load(config.verify_manifest, config.manifest_algorithm)) {
+        return 1;
+    }
+
+    std::cout << "Verifying " << verifier.getEntryCount() << " files ("
+              << config.max_concurrent << " per device)" << std::endl;
+
+    ManifestVerifier::Summary summary = verifier.run();
+
+    double mb = summary.bytes / (1024.0 * 1024.0);
+    double rate = summary.seconds > 0 ? mb / summary.seconds : 0;
+    std::cout << std::fixed << std::setprecision(1)
+              << "OK: " << summary.passed << " Mismatched: " << summary.mismatched
+              << " Unreadable: " << summary.unreadable << " Malformed: " << summary.malformed << std::endl;
+    std::cout << "Hashed " << CurlHttpClient::format_bytes(static_cast<curl_off_t>(summary.bytes))
+              << " in " << summary.seconds << "s (" << rate << " MB/s)" << std::endl;
+
+    bool clean = summary.passed == summary.files && summary.malformed == 0;
+    return clean ? 0 : 1;
+}
+
+int run_make_chunk_manifest(const Config& config) {
+    ChunkManifest manifest;
+    if (!manifest.build(config.make_chunk_manifest, ChecksumAlgorithm::Sha256, config.chunk_size)) {
+        return 1;
+    }
+
+    std::string output = config.make_chunk_manifest + ".chunks";
+    if (!manifest.save(output)) {
+        return 1;
+    }
+
+    std::cout << "Wrote " << output << ": " << manifest.chunk_count() << " chunks of "
+              << CurlHttpClient::format_bytes(static_cast<curl_off_t>(manifest.chunk_size())) << std::endl;
+    std::cout << "Root: " << Checksum::algorithm_name(manifest.algorithm()) << ":" << manifest.root() << std::endl;
+    return 0;
+}
+
 void test_thread_pool() {
     std::cout << "\n=== Testing ThreadPool ===\n\n";
     
@@ -140,6 +405,32 @@ void test_thread_pool() {
 
     std::cout << "  All void tasks completed. Counter = " << counter << "\n";
 
+    // Test 4: Tasks enqueued from tasks land on the worker's own deque and
+    // are stolen by the others; a burst from outside overflows the injection ring
+    std::cout << "\nTest 4: Nested tasks and bursts...\n";
+    std::atomic<int> leaves{0};
+    std::vector<std::future<std::future<void>>> parents;
+    for (int i = 0; i < 64; ++i) {
+        parents.emplace_back(pool.enqueue([&pool, &leaves] {
+            return pool.enqueue([&leaves] { leaves++; });
+        }));
+    }
+    for (auto& parent : parents) {
+        parent.get().get();
+    }
+    assert(leaves == 64);
+
+    std::vector<std::future<int>> burst;
+    for (int i = 0; i < 20000; ++i) {
+        burst.emplace_back(pool.enqueue([i] { return i; }));
+    }
+    long long sum = 0;
+    for (auto& f : burst) {
+        sum += f.get();
+    }
+    assert(sum == 19999LL * 20000 / 2);
+    std::cout << "  " << leaves << " nested and " << burst.size() << " burst tasks completed\n";
+
     std::cout << "\n=== ThreadPool tests complete ===\n\n";
 }
 
@@ -254,6 +545,211 @@ void test_download_task() {
     std::cout << "\n=== DownloadTask tests complete ===\n\n";
 }
 
+void test_progress_aggregator() {
+    std::cout << "\n=== Testing ProgressAggregator ===\n\n";
+
+    // Test 1: Throughput from the progress counters
+    std::cout << "Test 1: Progress aggregation...\n";
+    auto fast = std::make_shared<DownloadTask>("http://example.com/fast.bin", "fast.bin", 3, 300, "");
+    auto idle = std::make_shared<DownloadTask>("http://example.com/idle.bin", "idle.bin", 3, 300, "");
+    fast->start();
+    fast->updateProgress(0, 4000000);
+
+    ProgressAggregator aggregator(std::chrono::milliseconds(1));
+    auto t0 = std::chrono::steady_clock::now();
+    aggregator.sample({fast, idle}, t0);
+    fast->updateProgress(1000000, 4000000);
+    auto snapshot = aggregator.sample({fast, idle}, t0 + std::chrono::seconds(1));
+
+    std::cout << "  Rate: " << snapshot.bytesPerSecond << " B/s, ETA: " << snapshot.tasks[0].etaSeconds << "s\n";
+    assert(std::abs(snapshot.tasks[0].bytesPerSecond - 1000000.0) < 1.0);
+    assert(snapshot.tasks[1].bytesPerSecond == 0.0);
+    assert(std::abs(snapshot.tasks[0].etaSeconds - 3.0) < 0.01);
+    assert(snapshot.bytesDownloaded == 1000000 && snapshot.totalBytes == 4000000 && snapshot.active == 1);
+    std::cout << "  Per-task and global throughput correct\n";
+
+    std::cout << "\n=== ProgressAggregator tests complete ===\n\n";
+}
+
+void test_bandwidth_limiter() {
+    std::cout << "\n=== Testing BandwidthLimiter ===\n\n";
+
+    // Test 1: Weighted max-min shares of a global cap
+    std::cout << "Test 1: Weighted bandwidth shares...\n";
+    BandwidthLimiter& limiter = BandwidthLimiter::getInstance();
+    limiter.setRate(1000000);
+    uint64_t hotfix = limiter.addFlow(4.0);
+    uint64_t mirrorA = limiter.addFlow(1.0, 0, "mirror");
+    uint64_t mirrorB = limiter.addFlow(1.0, 0, "mirror");
+    uint64_t capped = limiter.addFlow(1.0, 100000);
+
+    //The capped flow can't use its sixth, the rest is split 4:1
+    std::cout << "  hotfix " << limiter.getFlowRate(hotfix) << ", mirror " << limiter.getFlowRate(mirrorA)
+              << " + " << limiter.getFlowRate(mirrorB) << ", capped " << limiter.getFlowRate(capped) << " B/s\n";
+    assert(limiter.getFlowRate(capped) == 100000);
+    assert(limiter.getFlowRate(hotfix) == 720000);
+    assert(limiter.getFlowRate(mirrorA) == 90000 && limiter.getFlowRate(mirrorB) == 90000);
+
+    limiter.setGroupWeight("mirror", 4.0);
+    assert(limiter.getFlowRate(mirrorA) == 225000 && limiter.getFlowRate(hotfix) == 450000);
+    limiter.setGroupWeight("mirror", 1.0);
+
+    //Departed flows leave their share to the others
+    limiter.removeFlow(hotfix);
+    limiter.removeFlow(capped);
+    assert(limiter.getFlowRate(mirrorA) == 500000);
+    limiter.removeFlow(mirrorA);
+    limiter.removeFlow(mirrorB);
+    limiter.setRate(0);
+    std::cout << "  Shares follow weights, groups and ceilings\n";
+
+    std::cout << "\n=== BandwidthLimiter tests complete ===\n\n";
+}
+
+void test_concurrency_controller() {
+    std::cout << "\n=== Testing ConcurrencyController ===\n\n";
+
+    // Test 1: AIMD concurrency decisions
+    std::cout << "Test 1: Adaptive concurrency...\n";
+    ConcurrencyController controller(2, 1, 8);
+    const double MB = 1024 * 1024;
+    auto step = [&controller](double goodput, size_t active, size_t queued) {
+        auto decision = controller.update({goodput, active, queued});
+        std::cout << "  " << decision.limit << ": " << decision.reason << "\n";
+        return decision;
+    };
+
+    assert(step(10 * MB, 2, 100).limit == 3);      //saturated: probe
+    assert(step(15 * MB, 3, 100).limit == 4);      //goodput grew: keep going
+    assert(step(15.2 * MB, 4, 100).limit == 3);    //flat, thinner streams: step back
+    assert(!step(15 * MB, 3, 100).changed);        //cooling down
+    controller.recordError();
+    assert(step(15 * MB, 3, 100).limit == 2);      //errors: multiplicative decrease
+
+    controller.recordLatency(0.05);
+    assert(!step(10 * MB, 2, 100).changed);        //baseline established, still cooling
+    controller.recordLatency(0.5);
+    assert(step(10 * MB, 2, 100).limit == 1);      //first byte 10x slower
+    assert(!step(10 * MB, 1, 0).changed);
+    std::cout << "  Limit follows goodput, errors and latency\n";
+
+    std::cout << "\n=== ConcurrencyController tests complete ===\n\n";
+}
+
+void test_run_queue() {
+    std::cout << "\n=== Testing RunQueue ===\n\n";
+
+    // Test 1: Host keys for per-host scheduling
+    std::cout << "Test 1: Host keys...\n";
+    assert(hostFromUrl("http://Example.com/file.zip") == "example.com:80");
+    assert(hostFromUrl("https://example.com") == "example.com:443");
+    assert(hostFromUrl("https://example.com:443/a?b") == "example.com:443");
+    assert(hostFromUrl("http://user:pw@mirror.local:8080/x") == "mirror.local:8080");
+    assert(hostFromUrl("ftp://[::1]/pub") == "[::1]:21");
+    assert(hostFromUrl("HTTP://Example.com/a") == hostFromUrl("http://example.com:80/b"));
+    assert(DownloadTask("https://cdn.example.com/a", "a", 3, 300, "").getHost() == "cdn.example.com:443");
+    std::cout << "  Host keys normalized\n";
+
+    // Test 2: Run queue order
+    std::cout << "\nTest 2: Run queue...\n";
+    RunQueue queue(2);
+    std::vector<std::shared_ptr<DownloadTask>> queued;
+    for (int i = 0; i < 4; ++i) {
+        queued.push_back(std::make_shared<DownloadTask>("http://big.example/" + std::to_string(i), "b", 3, 300, ""));
+        queue.push(queued.back());
+    }
+    queued.push_back(std::make_shared<DownloadTask>("http://small.example/0", "s", 3, 300, ""));
+    queue.push(queued.back());
+
+    assert(queue.pop() == queued[0]);   //oldest first
+    assert(queue.pop() == queued[4]);   //then the idle host
+    assert(queue.pop() == queued[1]);
+    assert(queue.pop() == nullptr);     //big.example at its limit, small.example drained
+    queue.release("big.example:80");
+    queued[2]->cancel();
+    assert(queue.pop() == queued[3]);   //canceled entry dropped
+    assert(queue.size() == 0);
+    assert(!queue.hasSlot("big.example:80"));   //a resume must not claim past the limit
+    assert(queue.hasSlot("small.example:80"));
+    std::cout << "  Hosts served fairly, FIFO within a host\n";
+
+    std::cout << "\n=== RunQueue tests complete ===\n\n";
+}
+
+void test_task_counts() {
+    std::cout << "\n=== Testing TaskStateCounts ===\n\n";
+
+    // Test 1: State counters follow every transition
+    std::cout << "Test 1: State counters...\n";
+    TaskStateCounts counts;
+    DownloadTask counted1("http://example.com/1", "1", 3, 300, "");
+    DownloadTask counted2("http://example.com/2", "2", 3, 300, "");
+    counted1.setStateCounts(&counts);
+    counted2.setStateCounts(&counts);
+    assert(counts.get(DownloadState::Queued) == 2);
+
+    counted1.start();
+    counted1.pause();
+    counted1.pause();                   //rejected, counts unchanged
+    assert(counts.get(DownloadState::Queued) == 1 && counts.get(DownloadState::Paused) == 1);
+    counted1.resume();
+    counted1.markCompleted();
+    counted2.cancel();
+    assert(counts.get(DownloadState::Completed) == 1 && counts.get(DownloadState::Canceled) == 1);
+    assert(counts.get(DownloadState::Queued) == 0 && counts.get(DownloadState::Downloading) == 0);
+    std::cout << "  Counts exact after start, pause, resume, complete, cancel\n";
+
+    std::cout << "\n=== TaskStateCounts tests complete ===\n\n";
+}
+
+void test_task_handles() {
+    std::cout << "\n=== Testing task handles ===\n\n";
+
+    // Test 1: Handles tell duplicate URLs apart
+    std::cout << "Test 1: Task handles...\n";
+    {
+        DownloadManager handles(2);
+        DownloadManager::TaskId first = handles.addDownload("http://example.com/same", "same1", 3, 300, "");
+        DownloadManager::TaskId second = handles.addDownload("http://example.com/same", "same2", 3, 300, "");
+        assert(first != second);
+        assert(handles.getTask(second)->getDesitnation() == "same2");
+
+        handles.cancelDownload(second);
+        assert(handles.getTask(first)->getState() == DownloadState::Queued);
+        assert(handles.getTask(second)->getState() == DownloadState::Canceled);
+        handles.cancelDownload(first);
+        assert(handles.getStateCount(DownloadState::Canceled) == 2);
+        assert(handles.getCompletedCount() == 2);
+        handles.waitForCompletion();     //nothing left outstanding
+    }
+    std::cout << "  Each handle reaches its own task\n";
+
+    std::cout << "\n=== Task handles tests complete ===\n\n";
+}
+
+void test_pause_barrier() {
+    std::cout << "\n=== Testing pause barrier ===\n\n";
+
+    // Test 1: A pause counts only once the worker acknowledges it
+    std::cout << "Test 1: Acknowledged pause...\n";
+    DownloadTask running("http://example.com/running", "running", 3, 300, "");
+    DownloadTask waiting("http://example.com/waiting", "waiting", 3, 300, "");
+    auto stopped = std::make_shared<CountdownLatch>(2);
+    running.start();
+    assert(running.pause(stopped));
+    assert(!waiting.pause(stopped));       //never started: caller counts it off
+    stopped->countDown();
+    assert(!stopped->waitFor(std::chrono::milliseconds(10)));
+    assert(!running.waitForPause(std::chrono::milliseconds(10)));
+    running.acknowledgeStop();          //worker stopped writing
+    assert(stopped->waitFor(std::chrono::milliseconds(0)));
+    assert(running.waitForPause(std::chrono::milliseconds(0)));
+    assert(running.requeue() && running.getState() == DownloadState::Queued);
+    std::cout << "  Barrier released by the worker, not by pause()\n";
+
+    std::cout << "\n=== Pause barrier tests complete ===\n\n";
+}
+
 void test_download_manager() {
     std::cout << "\n=== Testing DownloadManager ===\n\n";
     
@@ -316,7 +812,7 @@ void test_pause_resume() {
     DownloadManager manager(2);
     
     // Add a large download (so we have time to pause it)
-    manager.addDownload("https://httpbin.org/bytes/1000000", "large.bin", 3, 300, "");
+    DownloadManager::TaskId large = manager.addDownload("https://httpbin.org/bytes/1000000", "large.bin", 3, 300, "");
     
     manager.start();
     
@@ -326,13 +822,13 @@ void test_pause_resume() {
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     
     std::cout << "  Pausing download...\n";
-    manager.pauseDownload("https://httpbin.org/bytes/1000000");
+    manager.pauseDownload(large);
     
     std::cout << "  Download paused. Waiting 2 seconds...\n";
     std::this_thread::sleep_for(std::chrono::seconds(2));
     
     std::cout << "  Resuming download...\n";
-    manager.resumeDownload("https://httpbin.org/bytes/1000000");
+    manager.resumeDownload(large);
     
     manager.waitForCompletion();
     
@@ -353,3 +849,196 @@ void test_pause_resume() {
     std::cout << "\n=== Pause/Resume tests complete ===\n\n";
 }
 
+
+void test_chunk_repair() {
+    std::cout << "\n=== Testing chunk repair resume ===\n\n";
+
+    //Well under 2 segments, so only saved ranges can make it segmented
+    const std::string url = "https://httpbin.org/range/102400";
+    const uint64_t chunk_size = 16 * 1024;
+
+    // Test 1: Reference copy and manifests
+    std::cout << "Test 1: Download reference copy...\n";
+    std::filesystem::remove("repair_ref.bin");
+    std::filesystem::remove("repair.bin");
+    std::filesystem::remove("repair.bin.part");
+    std::filesystem::remove("repair.bin.part.segments");
+
+    Config config;
+    config.url = url;
+    config.output_path = "repair_ref.bin";
+    config.retry_count = 3;
+    config.timeout_seconds = 30;
+    {
+        CurlHttpClient client;
+        bool ok = client.download_and_verify(config);
+        assert(ok);
+    }
+    std::filesystem::copy_file("repair_ref.bin", "repair_bad.bin", std::filesystem::copy_options::overwrite_existing);
+    {
+        std::fstream bad("repair_bad.bin", std::ios::in | std::ios::out | std::ios::binary);
+        bad.seekp(static_cast<std::streamoff>(chunk_size + 10));
+        bad.put('#');
+    }
+
+    ChunkManifest good;
+    ChunkManifest wrong;
+    bool built = good.build("repair_ref.bin", ChecksumAlgorithm::Sha256, chunk_size) && good.save("repair_ref.bin.chunks")
+        && wrong.build("repair_bad.bin", ChecksumAlgorithm::Sha256, chunk_size) && wrong.save("repair_bad.bin.chunks");
+    assert(built);
+    std::cout << "  " << good.chunk_count() << " chunks of " << chunk_size << " bytes\n";
+
+    // Test 2: A manifest that never matches leaves the repair ranges behind
+    std::cout << "\nTest 2: Exhaust repair rounds...\n";
+    config.output_path = "repair.bin";
+    config.chunk_manifest = "repair_bad.bin.chunks";
+    {
+        CurlHttpClient client;
+        bool ok = client.download_and_verify(config);
+        assert(!ok);
+    }
+    assert(std::filesystem::exists("repair.bin.part"));
+    assert(std::filesystem::exists("repair.bin.part.segments"));
+    std::cout << "  .part and saved ranges kept: OK\n";
+
+    // Test 3: The rerun resumes the saved ranges, not the preallocated .part
+    std::cout << "\nTest 3: Rerun the repair...\n";
+    {
+        std::fstream part("repair.bin.part", std::ios::in | std::ios::out | std::ios::binary);
+        part.seekp(static_cast<std::streamoff>(chunk_size));
+        part << std::string(static_cast<size_t>(chunk_size), 'X');
+    }
+    config.chunk_manifest = "repair_ref.bin.chunks";
+    {
+        CurlHttpClient client;
+        bool ok = client.download_and_verify(config);
+        assert(ok);
+    }
+    assert(!std::filesystem::exists("repair.bin.part.segments"));
+
+    ChunkManifest repaired;
+    built = repaired.build("repair.bin", ChecksumAlgorithm::Sha256, chunk_size);
+    assert(built && repaired.root() == good.root());
+    std::cout << "  Repaired file matches reference: OK\n";
+
+    std::cout << "\n=== Chunk repair tests complete ===\n\n";
+}
+
+void test_event_stream() {
+    std::cout << "\n=== Testing EventStream ===\n\n";
+
+#ifndef _WIN32
+    // Test 1: A full ring still delivers lifecycle events
+    std::cout << "Test 1: Overflow keeps lifecycle events...\n";
+    int fds[2];
+    int piped = pipe(fds);
+    assert(piped == 0);
+
+    //Fill the pipe first, so the writer blocks on its first batch and the ring backs up
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    std::string blank(4096, '\n');
+    while (write(fds[1], blank.data(), blank.size()) > 0) {
+    }
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) & ~O_NONBLOCK);
+
+    const size_t QUEUED = 30000;    //well past the ring's 8192 slots
+    std::string url = "http://example.com/" + std::string(200, 'f');
+    EventStream events;
+    bool opened = events.open(std::to_string(fds[1]));
+    assert(opened);
+    for (size_t i = 0; i < QUEUED; ++i) {
+        events.emit(EventStream::Type::Queued, i, url, "out.bin");
+    }
+    events.emit(EventStream::Type::Completed, 7, url, "out.bin");
+
+    std::string text;
+    std::thread reader([&text, &fds] {
+        char buffer[65536];
+        ssize_t got;
+        while ((got = read(fds[0], buffer, sizeof(buffer))) > 0) {
+            text.append(buffer, static_cast<size_t>(got));
+        }
+    });
+    events.close();
+    ::close(fds[1]);
+    reader.join();
+    ::close(fds[0]);
+
+    std::istringstream lines(text);
+    std::string line;
+    std::string last;
+    size_t queued = 0;
+    size_t dropped = 0;
+    while (std::getline(lines, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        queued += line.find("\"event\":\"queued\"") != std::string::npos;
+        dropped += line.find("\"event\":\"dropped\"") != std::string::npos;
+        last = line;
+    }
+    std::cout << "  " << queued << " queued events, " << dropped << " drop notices\n";
+    assert(queued == QUEUED && dropped == 0);
+    assert(last.find("\"event\":\"completed\"") != std::string::npos);
+    assert(last.find("\"task\":7") != std::string::npos);
+    std::cout << "  Every event delivered, terminal event last\n";
+#else
+    std::cout << "Skipped: needs pipes\n";
+#endif
+
+    std::cout << "\n=== EventStream tests complete ===\n\n";
+}
+
+void test_manifest_verifier() {
+    std::cout << "\n=== Testing ManifestVerifier ===\n\n";
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "manifest_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::ofstream(dir / "empty.bin", std::ios::binary);
+    std::ofstream(dir / "abc.txt", std::ios::binary) << "abc";
+
+    //As written by b3sum: bare 64-hex digests, same length as SHA-256
+    const std::string b3sums =
+        "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262  empty.bin\n"
+        "6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85  abc.txt\n";
+    std::ofstream(dir / "B3SUMS") << b3sums;
+    std::ofstream(dir / "sums.txt") << b3sums;
+    std::ofstream(dir / "SHA256SUMS")
+        << "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855  empty.bin\n"
+        << "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad *abc.txt\n";
+
+    auto verify = [&dir](const std::string& manifest, const std::string& algorithm) {
+        ManifestVerifier verifier(2);
+        bool loaded = verifier.load(dir / manifest, algorithm);
+        assert(loaded);
+        ManifestVerifier::Summary summary = verifier.run();
+        std::cout << "  " << manifest << (algorithm.empty() ? "" : " as " + algorithm) << ": "
+                  << summary.passed << "/" << summary.files << " OK\n";
+        return summary;
+    };
+
+    // Test 1: A b3sum manifest is recognized by its name
+    std::cout << "Test 1: B3SUMS...\n";
+    ChecksumAlgorithm named;
+    assert(ManifestVerifier::algorithmFromName("B3SUMS", named) && named == ChecksumAlgorithm::Blake3);
+    assert(ManifestVerifier::algorithmFromName("SHA512SUMS.txt", named) && named == ChecksumAlgorithm::Sha512);
+    assert(!ManifestVerifier::algorithmFromName("sums.txt", named));
+    ManifestVerifier::Summary summary = verify("B3SUMS", "");
+    assert(summary.passed == 2 && summary.malformed == 0);
+
+    // Test 2: Any name, with the algorithm given
+    std::cout << "\nTest 2: Explicit algorithm...\n";
+    summary = verify("sums.txt", "blake3");
+    assert(summary.passed == 2);
+    summary = verify("sums.txt", "");
+    assert(summary.passed == 0 && summary.mismatched == 2);    //64 hex digits read as SHA-256
+
+    // Test 3: SHA-256 manifests are unaffected
+    std::cout << "\nTest 3: SHA256SUMS...\n";
+    summary = verify("SHA256SUMS", "");
+    assert(summary.passed == 2);
+
+    std::filesystem::remove_all(dir);
+    std::cout << "\n=== ManifestVerifier tests complete ===\n\n";
+}
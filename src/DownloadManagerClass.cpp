@@ -1,12 +1,23 @@
 #include "DownloadManagerClass.h"
 #include "Logger.h"
+#include "BandwidthLimiter.h"
+#include <algorithm>
 
 DownloadManager::DownloadManager(size_t maxConcurrent)
-    : pool_(maxConcurrent)
+    : pool_(std::max<size_t>(1, std::thread::hardware_concurrency()))
+    , finishedBytes_(0)
+    , finishedTotalBytes_(0)
+    , maxHold_(0)
     , activeCount_(0)
     , maxConcurrent_(maxConcurrent)
+    , maxPerHost_(0)
+    , controllerInterval_(std::chrono::seconds(2))
+    , controllerStop_(false)
     , running_(false)
     , completedCount_(0)
+    , totalCount_(0)
+    , outstanding_(0)
+    , events_(nullptr)
 {
     LOG_INFO("Created DownloadManager with max " + std::to_string(maxConcurrent) + " concurrent downloads");
 }
@@ -14,28 +25,85 @@ DownloadManager::DownloadManager(size_t maxConcurrent)
 DownloadManager::~DownloadManager() {
     LOG_INFO("Destroying DownloadManager");
     waitForCompletion();
+    stopController();
 }
 
-void DownloadManager::addDownload(const std::string& url, const std::string& destination, int retryCount, int timeoutSeconds, const std::string& checksum) {
-    auto task = std::make_shared<DownloadTask>(url, destination, retryCount, timeoutSeconds, checksum);
+DownloadManager::TaskId DownloadManager::addDownload(const std::string& url, const std::string& destination, int retryCount, int timeoutSeconds, const std::string& checksum, int segments,
+                                  double weight, uint64_t maxBytesPerSecond, const std::string& group) {
+    auto task = std::make_shared<DownloadTask>(url, destination, retryCount, timeoutSeconds, checksum, segments,
+                                               weight, maxBytesPerSecond, group);
+    task->setStateCounts(&stateCounts_);
+    outstanding_.fetch_add(1);
 
+    TaskId id = 0;
     {
         std::lock_guard<std::mutex> lock(taskMutex_);
+        id = tasks_.size();
+        task->setId(id);
         tasks_.push_back(task);
+        urlIndex_.emplace(url, id);
+        runQueue_.push(task);
+        totalCount_.fetch_add(1);
     }
 
     LOG_INFO("Added download: " + url + " -> " + destination);
+    emitEvent(EventStream::Type::Queued, task);
+    return id;
+}
+
+void DownloadManager::setGroupWeight(const std::string& group, double weight) {
+    BandwidthLimiter::getInstance().setGroupWeight(group, weight);
+}
+
+void DownloadManager::setAdaptiveConcurrency(size_t minConcurrent, size_t maxConcurrent, std::chrono::milliseconds interval) {
+    controller_ = std::make_unique<ConcurrencyController>(maxConcurrent_.load(), minConcurrent, maxConcurrent);
+    controllerInterval_ = interval;
+    maxConcurrent_.store(controller_->getLimit());
+    LOG_INFO("Adaptive concurrency: " + std::to_string(minConcurrent) + "-" + std::to_string(maxConcurrent) +
+             ", starting at " + std::to_string(maxConcurrent_.load()));
+}
+
+void DownloadManager::setPauseHold(std::chrono::milliseconds maxHold) {
+    std::lock_guard<std::mutex> lock(taskMutex_);
+    maxHold_ = maxHold;
+}
+
+void DownloadManager::setMaxPerHost(size_t maxPerHost) {
+    maxPerHost_ = maxPerHost;
+    {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        runQueue_.setMaxPerHost(maxPerHost);
+    }
+    LOG_INFO("Max " + std::to_string(maxPerHost) + " concurrent downloads per host");
 }
 
 void DownloadManager::start() {
     running_.store(true);
     LOG_INFO("Starting DownloadManager");
 
+    //Let curl hold the same line, allowing for every segment of a host's downloads
+    if (maxPerHost_ > 0) {
+        int segments = 1;
+        {
+            std::lock_guard<std::mutex> lock(taskMutex_);
+            for (const auto& task : tasks_) {
+                segments = std::max(segments, task->getSegments());
+            }
+        }
+        engine_.setMaxHostConnections(static_cast<long>(maxPerHost_ * segments));
+    }
+    engine_.start();
+
+    if (controller_ && !controllerThread_.joinable()) {
+        controllerStop_ = false;
+        controllerThread_ = std::thread(&DownloadManager::runController, this);
+    }
+
     //Launch initial batch of downloads (up to maxConcurrent_)
     size_t tasksToStart = 0;
     {
         std::lock_guard<std::mutex> lock(taskMutex_);
-        tasksToStart = std::min(tasks_.size(), maxConcurrent_);
+        tasksToStart = std::min(tasks_.size(), maxConcurrent_.load());
     }
 
     // Start tasks outside the lock to avoid deadlock
@@ -50,118 +118,306 @@ void DownloadManager::processNextTask() {
 
     {
         std::lock_guard<std::mutex> lock(taskMutex_);
-        for (auto& t : tasks_) {
-            if (t->getState() == DownloadState::Queued) {
-                task = t;
-                break;
-            }
+
+        //Check if we can start another download
+        if (activeCount_.load() >= maxConcurrent_) {
+            return; //Already at max concurrent
         }
-    }
 
-    if (!task) {
-        return; //No queued tasks
-    }
+        //Oldest queued task of the least busy host that still has a free slot,
+        //so one host with thousands of URLs can't take every slot
+        task = runQueue_.pop();
 
-    //Check if we can start another download
-    if (activeCount_.load() >= maxConcurrent_) {
-        return; //Already at max concurrent
-    }
+        if (!task) {
+            return; //No queued tasks, or all of their hosts are at their limit
+        }
 
-    //Increment active count
-    activeCount_.fetch_add(1);
+        //Claim the task under the lock so concurrent callers can't pick it too
+        activeCount_.fetch_add(1);
+        task->start();
+    }
 
-    //Submit to thread pool
-    pool_.enqueue([this, task] {
-        downloadTask(task);
-    });
+    emitEvent(EventStream::Type::Started, task);
+    downloadTask(task);
 }
 
 void DownloadManager::downloadTask(std::shared_ptr<DownloadTask> task) {
-    LOG_INFO("Starting download worker for: " + task->getUrl());
-
-    //Mark task as started
-    task->start();
+    LOG_INFO("Submitting download to transfer engine: " + task->getUrl());
 
-    //Create HTTP client
-    CurlHttpClient httpClient;
+    //Create HTTP client, owned by the completion callback
+    auto httpClient = std::make_shared<CurlHttpClient>();
+    httpClient->set_segments(task->getSegments());
 
     //Convert task to config
     Config config = task->toConfig();
+    httpClient->set_stream_checksum(config);
+
+    //Concurrent bars would garble the console: progress is only published,
+    //and rendered (if at all) by a ProgressDashboard
+    httpClient->set_show_progress(false);
+
+    //Bytes in flight go straight into the task's counters (engine thread, lock-free).
+    //The first ones also time the request for the concurrency controller.
+    auto submitted = std::chrono::steady_clock::now();
+    auto startBytes = static_cast<curl_off_t>(task->getBytesDownloaded());
+    auto firstBytes = std::make_shared<bool>(controller_ == nullptr);
+    httpClient->set_progress_listener([this, task, submitted, startBytes, firstBytes](curl_off_t downloaded, curl_off_t total) {
+        task->updateProgress(static_cast<size_t>(std::max<curl_off_t>(downloaded, 0)),
+                             static_cast<size_t>(std::max<curl_off_t>(total, 0)));
+        if (!*firstBytes && downloaded > startBytes) {
+            *firstBytes = true;
+            controller_->recordLatency(std::chrono::duration<double>(std::chrono::steady_clock::now() - submitted).count());
+        }
+    });
+
+    httpClient->set_retry_listener([this, task](int attempt, const std::string& reason) {
+        if (controller_) {
+            controller_->recordError();
+        }
+        emitEvent(EventStream::Type::Retry, task, reason, attempt);
+    });
+
+    //Only holds a share while on the wire, so finished and paused tasks leave theirs to the others.
+    //Without a global cap or a ceiling there is nothing to share out (weights and groups only
+    //split a cap): no flow, so writes stay on the limiter's lock-free path.
+    BandwidthLimiter& limiter = BandwidthLimiter::getInstance();
+    uint64_t flow = 0;
+    if (limiter.enabled() || task->getMaxBytesPerSecond() > 0) {
+        flow = limiter.addFlow(task->getWeight(), task->getMaxBytesPerSecond(), task->getGroup());
+        httpClient->set_bandwidth_flow(flow);
+    }
 
-    // Create shouldContinue callback that checks task state
-    auto shouldContinue = [task]() -> bool {
-        return task->shouldContinue();
+    // Create shouldContinue callback that checks task state (a held pause keeps going)
+    auto held = std::make_shared<std::atomic<bool>>(false);
+    auto shouldContinue = [task, held]() -> bool {
+        return task->shouldContinue() || held->load();
     };
 
-    //Perform the download
-    bool success = httpClient.download_and_verify(config, shouldContinue);
+    if (!httpClient->prepare(config.url, config.output_path, config.retry_count,
+                             config.timeout_seconds, config.connect_timeout_seconds, shouldContinue)) {
+        if (flow != 0) {
+            limiter.removeFlow(flow);
+        }
+        finishTask(task, false);
+        return;
+    }
 
+    //Runs on the engine thread once the transfer (including retries) is done.
+    //Registered under the lock so finishTask can't drop the entry before it exists
+    std::lock_guard<std::mutex> lock(taskMutex_);
+    live_.emplace(task->getId(), task);
+    InFlight& entry = inFlight_[task->getId()];
+    entry.held = held;
+    entry.transfer = engine_.submit(httpClient.get(), [this, task, httpClient, config, flow](bool success) {
+        if (flow != 0) {
+            BandwidthLimiter::getInstance().removeFlow(flow);
+        }
+
+        //The last callback may predate the last bytes
+        curl_off_t size = httpClient->get_content_length();
+        if (success && size > 0) {
+            task->updateProgress(static_cast<size_t>(size), static_cast<size_t>(size));
+        }
+
+        if (success && config.verify_checksum) {
+            const std::string& streamed = httpClient->get_streamed_checksum();
+            if (streamed.empty()) {
+                //Not hashed in flight (segmented): re-reading the file stays off the engine thread
+                pool_.enqueue([this, task, config] {
+                    finishTask(task, CurlHttpClient::verify_download(config));
+                });
+                return;
+            }
+            success = CurlHttpClient::verify_download(config, streamed);
+        }
+        finishTask(task, success);
+    });
+}
+
+void DownloadManager::finishTask(std::shared_ptr<DownloadTask> task, bool success) {
     //Update task state
     if (!success && task->getState() == DownloadState::Paused) {
         // Paused successfully - don't mark as failed
         LOG_INFO("Download paused: " + task->getUrl());
+    } else if (task->getState() == DownloadState::Canceled) {
+        // Stopped on request - neither a success nor an error
+        LOG_INFO("Download stopped after cancel: " + task->getUrl());
     } else if (success) {
         task->markCompleted();
     } else {
         task->markFailed("Download failed");
+        if (controller_) {
+            controller_->recordError();
+        }
     }
 
-    //Decrement active count
-    if (task->getState() != DownloadState::Paused) {
+    //Decrement active count. The outcome is read once, in the same critical section
+    //that drops the in-flight entry: after that a resume may already move the task on
+    DownloadState state;
+    bool resume = false;
+    bool reported = false;
+    {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        state = task->getState();
+        runQueue_.release(task->getHost());
+        auto it = inFlight_.find(task->getId());
+        if (it != inFlight_.end()) {
+            reported = it->second.heldReported;
+            inFlight_.erase(it);
+        }
+        if (state != DownloadState::Paused) {
+            retireTask(task);
+        }
+        resume = resumeWhenStopped_.erase(task->getId()) > 0;
         activeCount_.fetch_sub(1);
+
+        //The worker is done with the task: this is what a pause waits for.
+        //Acknowledged before a resume can start the next run, which clears it again
+        task->acknowledgeStop();
+    }
+
+    //Canceled: nothing will resume from the partial file
+    if (state == DownloadState::Canceled) {
+        CurlHttpClient::remove_partial(task->getDesitnation());
+    }
+
+    //Paused tasks hold on to their outstanding count and are not done yet
+    if (state != DownloadState::Paused) {
         completedCount_.fetch_add(1);
         
         // Try to start next queued task
         if (running_.load()) {
             processNextTask();
         }
-    } else {
-        // Paused - just decrement active (don't increment completed)
-        activeCount_.fetch_sub(1);
     }
 
     LOG_INFO("Download worker finished: " + task->getUrl() + 
-             " (state: " + stateToString(task->getState()) + ")");
-    
-    //Notify waiters
-    workAvailable_.notify_all();
+             " (state: " + stateToString(state) + ")");
+
+    switch (state) {
+        case DownloadState::Paused:
+            //A hold that ran out was reported when it began
+            if (!reported) {
+                emitEvent(EventStream::Type::Paused, task);
+            }
+            break;
+        case DownloadState::Completed:
+            emitEvent(EventStream::Type::Completed, task);
+            break;
+        case DownloadState::Canceled:
+            emitEvent(EventStream::Type::Canceled, task);
+            break;
+        default:
+            emitEvent(EventStream::Type::Failed, task, task->getErrorMessage());
+            break;
+    }
+
+    //A resume that came while the transfer was still stopping (before the decrement, so waiters don't wake)
+    if (resume && state == DownloadState::Paused) {
+        resumeTask(task);
+    }
+
+    //Last outcome: wake waiters (under the lock, so the wake can't slip between check and wait)
+    if (outstanding_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(doneMutex_);
+        allDone_.notify_all();
+    }
 }
 
 void DownloadManager::waitForCompletion() {
     LOG_INFO("Waiting for all downloads to complete...");
 
-    std::unique_lock<std::mutex> lock(taskMutex_);
+    std::unique_lock<std::mutex> lock(doneMutex_);
 
-    //Wait until all tasks are done (not queued or downloading)
-    workAvailable_.wait(lock, [this] {
-        for (const auto& task : tasks_) {
-            DownloadState state = task->getState();
-            if (state == DownloadState::Queued || state == DownloadState::Downloading) {
-                return false; //Still work to do
-            }
-        }
-
-        return true; // All done
+    //Wait until every task has finished, failed or paused
+    allDone_.wait(lock, [this] {
+        return outstanding_.load() == 0;
     });
     running_.store(false);
     LOG_INFO("All downloads complete");
+    lock.unlock();
+
+    stopController();
 }
 
-size_t DownloadManager::getActiveCount() const {
-    return activeCount_.load();
+size_t DownloadManager::bytesSoFar() const {
+    size_t bytes = finishedBytes_;
+    for (const auto& entry : live_) {
+        bytes += entry.second->getBytesDownloaded();
+    }
+    return bytes;
 }
 
-size_t DownloadManager::getQueuedCount() const {
-    std::lock_guard<std::mutex> lock(taskMutex_);
+void DownloadManager::retireTask(const std::shared_ptr<DownloadTask>& task) {
+    if (live_.erase(task->getId()) > 0) {
+        finishedBytes_ += task->getBytesDownloaded();
+        finishedTotalBytes_ += task->getTotalBytes();
+    }
+}
+
+void DownloadManager::runController() {
+    //Only started, unfinished tasks are walked, the lock is shared with scheduling
+    auto sampleBytes = [this] {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        return bytesSoFar();
+    };
+
+    size_t lastBytes = sampleBytes();
+    auto lastTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(controllerMutex_);
+    while (!controllerWake_.wait_for(lock, controllerInterval_, [this] { return controllerStop_; })) {
+        lock.unlock();
+
+        //Restarted transfers can shrink the total, that interval just counts as zero
+        size_t bytes = sampleBytes();
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - lastTime).count();
+        double goodput = bytes > lastBytes && elapsed > 0 ? (bytes - lastBytes) / elapsed : 0.0;
+        lastBytes = bytes;
+        lastTime = now;
 
-    size_t count = 0;
-    for (const auto& task : tasks_) {
-        if (task->getState() == DownloadState::Queued) {
-            ++count;
+        ConcurrencyController::Sample sample{goodput, activeCount_.load(), getQueuedCount()};
+        ConcurrencyController::Decision decision = controller_->update(sample);
+
+        if (decision.changed) {
+            LOG_INFO("Concurrency " + decision.reason);
+            size_t previous = maxConcurrent_.exchange(decision.limit);
+
+            //Fill the new slots now; a lower limit takes effect as transfers finish
+            for (size_t i = previous; i < decision.limit && running_.load(); ++i) {
+                processNextTask();
+            }
+        } else {
+            LOG_DEBUG("Concurrency held at " + std::to_string(decision.limit) + ": " + decision.reason);
         }
+
+        lock.lock();
+    }
+}
+
+void DownloadManager::stopController() {
+    {
+        std::lock_guard<std::mutex> lock(controllerMutex_);
+        controllerStop_ = true;
     }
+    controllerWake_.notify_all();
 
-    return count;
+    if (controllerThread_.joinable()) {
+        controllerThread_.join();
+    }
+}
+
+size_t DownloadManager::getActiveCount() const {
+    return activeCount_.load();
+}
+
+size_t DownloadManager::getQueuedCount() const {
+    return stateCounts_.get(DownloadState::Queued);
+}
+
+size_t DownloadManager::getStateCount(DownloadState state) const {
+    return stateCounts_.get(state);
 }
 
 size_t DownloadManager::getCompletedCount() const {
@@ -169,97 +425,323 @@ size_t DownloadManager::getCompletedCount() const {
 }
 
 size_t DownloadManager::getTotalCount() const {
+    return totalCount_.load();
+}
+
+std::shared_ptr<DownloadTask> DownloadManager::getTask(TaskId id) const {
+    return findTask(id);
+}
+
+std::shared_ptr<DownloadTask> DownloadManager::findTask(TaskId id) const {
     std::lock_guard<std::mutex> lock(taskMutex_);
-    return tasks_.size();
+
+    if (id >= tasks_.size()) {
+        return nullptr;
+    }
+
+    return tasks_[id];
 }
 
-std::shared_ptr<DownloadTask> DownloadManager::getTask(size_t index) const {
+std::shared_ptr<DownloadTask> DownloadManager::findTask(const std::string& url) const {
     std::lock_guard<std::mutex> lock(taskMutex_);
 
-    if (index >= tasks_.size()) {
+    auto it = urlIndex_.find(url);
+    if (it == urlIndex_.end()) {
         return nullptr;
     }
 
-    return tasks_[index];
+    return tasks_[it->second];
 }
 
-void DownloadManager::pauseDownload(const std::string& url) {
-    std::shared_ptr<DownloadTask> task;
+void DownloadManager::emitEvent(EventStream::Type type, const std::shared_ptr<DownloadTask>& task, const std::string& message, int attempt) {
+    if (!events_) {
+        return;
+    }
+
+    //Tasks are identified by their TaskId, as in getTask()
+    events_->emit(type, task->getId(), task->getUrl(), task->getDesitnation(), message, attempt);
+}
+
+ProgressAggregator::Snapshot DownloadManager::getProgress() {
+    std::vector<std::shared_ptr<DownloadTask>> tasks;
+    size_t finishedBytes = 0;
+    size_t finishedTotalBytes = 0;
     {
         std::lock_guard<std::mutex> lock(taskMutex_);
-        for (auto& t : tasks_) {
-            if (t->getUrl() == url) {
-                task = t;
-                break;
-            }
+        tasks.reserve(live_.size());
+        for (const auto& entry : live_) {
+            tasks.push_back(entry.second);
         }
+        finishedBytes = finishedBytes_;
+        finishedTotalBytes = finishedTotalBytes_;
     }
 
+    //Queued tasks have no bytes yet, finished ones only count in the totals
+    ProgressAggregator::Snapshot snapshot = progress_.sample(tasks);
+    snapshot.bytesDownloaded += finishedBytes;
+    snapshot.totalBytes += finishedTotalBytes;
+    return snapshot;
+}
+
+void DownloadManager::pauseDownload(TaskId id) {
+    std::shared_ptr<DownloadTask> task = findTask(id);
+    if (!task) {
+        LOG_WARN("Cannot pause: no task " + std::to_string(id));
+        return;
+    }
+    pauseTask(task);
+}
+
+void DownloadManager::pauseDownload(const std::string& url) {
+    std::shared_ptr<DownloadTask> task = findTask(url);
     if (!task) {
         LOG_WARN("Cannot pause: task not found: " + url);
         return;
     }
+    pauseTask(task);
+}
+
+void DownloadManager::interruptTask(const std::shared_ptr<DownloadTask>& task) {
+    std::lock_guard<std::mutex> lock(taskMutex_);
+    auto it = inFlight_.find(task->getId());
+    if (it != inFlight_.end()) {
+        it->second.held->store(false);
+        engine_.interrupt(it->second.transfer);
+    }
+}
+
+bool DownloadManager::requestPause(const std::shared_ptr<DownloadTask>& task, const std::shared_ptr<CountdownLatch>& stopped) {
+    std::lock_guard<std::mutex> lock(taskMutex_);
+    auto it = inFlight_.find(task->getId());
+    bool hold = maxHold_.count() > 0 && it != inFlight_.end();
+
+    //Set before the state changes, so no callback aborts the transfer in between
+    if (hold) {
+        it->second.held->store(true);
+    }
+    if (!task->pause(stopped)) {
+        if (hold) {
+            it->second.held->store(false);
+        }
+        return false;
+    }
 
-    task->pause();
+    if (hold) {
+        TaskId id = task->getId();
+        engine_.hold(it->second.transfer, maxHold_,
+                     [this, task] { holdStarted(task); },
+                     [this, id] { return expireHold(id); });
+    } else if (it != inFlight_.end()) {
+        engine_.interrupt(it->second.transfer);
+    }
+    return true;
+}
 
-    //Wait for confirmation (with timeout)
+void DownloadManager::holdStarted(const std::shared_ptr<DownloadTask>& task) {
+    bool report = false;
+    {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        auto it = inFlight_.find(task->getId());
+        report = it != inFlight_.end() && it->second.held->load();
+        if (report) {
+            it->second.heldReported = true;
+        }
+    }
+
+    task->acknowledgeStop();
+    if (report) {
+        emitEvent(EventStream::Type::Paused, task, "held");
+    }
+}
+
+bool DownloadManager::expireHold(TaskId id) {
+    std::lock_guard<std::mutex> lock(taskMutex_);
+    auto it = inFlight_.find(id);
+    if (it == inFlight_.end() || !it->second.held->load()) {
+        return false; //Resumed (or canceled) in the meantime
+    }
+
+    it->second.held->store(false);
+    LOG_INFO("Pause of " + tasks_[id]->getUrl() + " outlasted " + std::to_string(maxHold_.count()) +
+             " ms, closing its connections");
+    return true;
+}
+
+void DownloadManager::pauseTask(const std::shared_ptr<DownloadTask>& task) {
+    if (!requestPause(task, nullptr)) {
+        return;
+    }
+
+    //Wait for the worker to stop (with timeout)
     if (!task->waitForPause(std::chrono::seconds(5))) {
-        LOG_ERROR("Pause failed for: " + url);
+        LOG_ERROR("Pause failed for: " + task->getUrl());
     }
 }
 
+bool DownloadManager::pauseTasks(const std::vector<std::shared_ptr<DownloadTask>>& tasks, std::chrono::milliseconds timeout) {
+    //Tasks that turn out not to be downloading count themselves off right away
+    auto stopped = std::make_shared<CountdownLatch>(tasks.size());
+    for (const auto& task : tasks) {
+        if (!requestPause(task, stopped)) {
+            stopped->countDown();
+        }
+    }
+
+    if (!stopped->waitFor(timeout)) {
+        LOG_ERROR(std::to_string(stopped->remaining()) + " of " + std::to_string(tasks.size()) +
+                  " downloads still running after pause deadline");
+        return false;
+    }
+    return true;
+}
+
+bool DownloadManager::pauseDownloads(const std::vector<TaskId>& ids, std::chrono::milliseconds timeout) {
+    std::vector<std::shared_ptr<DownloadTask>> tasks;
+    tasks.reserve(ids.size());
+    {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        for (TaskId id : ids) {
+            if (id < tasks_.size()) {
+                tasks.push_back(tasks_[id]);
+            }
+        }
+    }
+
+    LOG_INFO("Pausing " + std::to_string(tasks.size()) + " downloads");
+    return pauseTasks(tasks, timeout);
+}
+
+void DownloadManager::resumeDownload(TaskId id) {
+    std::shared_ptr<DownloadTask> task = findTask(id);
+    if (!task || task->getState() != DownloadState::Paused) {
+        LOG_WARN("Cannot resume: no paused task " + std::to_string(id));
+        return;
+    }
+    resumeTask(task);
+}
+
 void DownloadManager::resumeDownload(const std::string& url) {
-    std::shared_ptr<DownloadTask> task;
+    std::shared_ptr<DownloadTask> task = findTask(url);
+    if (!task || task->getState() != DownloadState::Paused) {
+        LOG_WARN("Cannot resume: task not found or not paused: " + url);
+        return;
+    }
+    resumeTask(task);
+}
 
+void DownloadManager::resumeTask(const std::shared_ptr<DownloadTask>& task) {
+    bool started = false;
+    bool requeued = false;
+    bool continued = false;
     {
         std::lock_guard<std::mutex> lock(taskMutex_);
-        for (auto& t : tasks_) {
-            if (t->getUrl() == url && t->getState() == DownloadState::Paused) {
-                task = t;
-                break;
+
+        auto it = inFlight_.find(task->getId());
+        if (it != inFlight_.end()) {
+            if (!it->second.held->load()) {
+                //Still stopping: finishTask resumes it once the worker is done
+                if (task->getState() == DownloadState::Paused) {
+                    resumeWhenStopped_.insert(task->getId());
+                }
+                return;
+            }
+
+            //Held in place: continue on the same connections, slot and all
+            continued = task->resume();
+            if (continued) {
+                it->second.held->store(false);
+                it->second.heldReported = false;
+                engine_.release(it->second.transfer);
+            }
+        } else if (activeCount_.load() < maxConcurrent_ && runQueue_.hasSlot(task->getHost())) {
+            // Resume the task (will restart download)
+            started = task->resume();
+            if (started) {
+                activeCount_.fetch_add(1);
+                runQueue_.claim(task->getHost());
             }
+        } else {
+            //No free slot (overall or on its host): back into the run queue, as if it had just been added
+            requeued = task->requeue();
+            if (requeued) {
+                runQueue_.push(task);
+            }
+        }
+
+        if (started || requeued) {
+            outstanding_.fetch_add(1);
         }
     }
 
+    if (requeued) {
+        emitEvent(EventStream::Type::Queued, task, "resumed");
+    }
+    if (continued) {
+        emitEvent(EventStream::Type::Started, task, "resumed in place");
+    }
+    if (started) {
+        emitEvent(EventStream::Type::Started, task, "resumed");
+        downloadTask(task);
+    }
+}
+
+void DownloadManager::cancelDownload(TaskId id) {
+    std::shared_ptr<DownloadTask> task = findTask(id);
     if (!task) {
-        LOG_WARN("Cannot resume: task not found or not paused: " + url);
+        LOG_WARN("Cannot cancel: no task " + std::to_string(id));
         return;
     }
-    
-    // Resume the task (will restart download)
-    task->resume();
 
-    if (activeCount_.load() < maxConcurrent_) {
-        activeCount_.fetch_add(1);
-        
-        pool_.enqueue([this, task] {
-            downloadTask(task);
-        });
+    //Queued tasks only leave that state under taskMutex_, so this can't race a start.
+    //Neither can a paused one whose transfer is gone: restarting it takes the lock too.
+    bool wasQueued = false;
+    bool wasPaused = false;
+    {
+        std::lock_guard<std::mutex> lock(taskMutex_);
+        wasQueued = task->getState() == DownloadState::Queued;
+        wasPaused = task->getState() == DownloadState::Paused && inFlight_.count(task->getId()) == 0;
+        task->cancel();
+        if (wasPaused) {
+            retireTask(task);
+        }
+    }
+
+    if (task->getState() != DownloadState::Canceled) {
+        return; //Already finished
+    }
+
+    //A running transfer is stopped now, and finishTask frees its slot and records it.
+    //A queued one never reaches finishTask (the run queue drops it): record it here.
+    //So is a paused one, but finishTask already gave up its outstanding count at the pause.
+    interruptTask(task);
+    CurlHttpClient::remove_partial(task->getDesitnation());
+    if (wasPaused) {
+        completedCount_.fetch_add(1);
+        emitEvent(EventStream::Type::Canceled, task);
+    } else if (wasQueued) {
+        completedCount_.fetch_add(1);
+        emitEvent(EventStream::Type::Canceled, task);
+        if (outstanding_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(doneMutex_);
+            allDone_.notify_all();
+        }
     }
 }
 
-void DownloadManager::pauseAll() {
+bool DownloadManager::pauseAll(std::chrono::milliseconds timeout) {
     std::vector<std::shared_ptr<DownloadTask>> activeTasks;
 
     {
         std::lock_guard<std::mutex> lock(taskMutex_);
         for (auto& t : tasks_) {
             if (t->getState() == DownloadState::Downloading) {
-                t->pause();
                 activeTasks.push_back(t);
             }
         }
     }
 
-    LOG_INFO("Pausing" + std::to_string(activeTasks.size()) + " downloads");
-    for (auto& task: activeTasks) {
-        task->pause();
-    }
-
-    // Wait for all to pause
-    for (auto& task : activeTasks) {
-        task->waitForPause(std::chrono::seconds(5));
-    }
+    LOG_INFO("Pausing " + std::to_string(activeTasks.size()) + " downloads");
+    return pauseTasks(activeTasks, timeout);
 }
 
 void DownloadManager::resumeAll() {
@@ -277,6 +759,6 @@ void DownloadManager::resumeAll() {
     LOG_INFO("Resuming " + std::to_string(pausedTasks.size()) + " downloads");
     
     for (auto& task: pausedTasks) {
-        resumeDownload(task->getUrl());
+        resumeTask(task);
     }
 }
\ No newline at end of file
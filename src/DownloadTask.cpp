@@ -1,5 +1,7 @@
 #include "DownloadTask.h"
 #include "Logger.h"
+#include "Checksum.h"
+#include "Url.h"
 
 std::string stateToString(DownloadState state) {
     switch (state) {
@@ -20,23 +22,80 @@ std::string stateToString(DownloadState state) {
     }
 }
 
-DownloadTask::DownloadTask(const std::string& url, const std::string& destination, int retryCount, int timeoutSeconds, const std::string& checksum) 
+TaskStateCounts::TaskStateCounts() {
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t TaskStateCounts::get(DownloadState state) const {
+    return counts_[static_cast<size_t>(state)].load(std::memory_order_relaxed);
+}
+
+void TaskStateCounts::add(DownloadState state) {
+    counts_[static_cast<size_t>(state)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void TaskStateCounts::move(DownloadState from, DownloadState to) {
+    if (from == to) {
+        return;
+    }
+    counts_[static_cast<size_t>(to)].fetch_add(1, std::memory_order_relaxed);
+    counts_[static_cast<size_t>(from)].fetch_sub(1, std::memory_order_relaxed);
+}
+
+DownloadTask::DownloadTask(const std::string& url, const std::string& destination, int retryCount, int timeoutSeconds, const std::string& checksum, int segments,
+                           double weight, uint64_t maxBytesPerSecond, const std::string& group)
     : url_(url)
     , destination_(destination)
-    , state_(DownloadState::Queued)
     , retryCount_(retryCount)
     , timeoutSeconds_(timeoutSeconds)
     , connectTimeoutSeconds_(30)
     , expectedChecksum_(checksum)
+    , segments_(segments)
+    , weight_(weight)
+    , maxBytesPerSecond_(maxBytesPerSecond)
+    , group_(group)
+    , host_(hostFromUrl(url))
+    , id_(0)
+    , state_(DownloadState::Queued)
+    , stateCounts_(nullptr)
     , bytesDownloaded_(0)
     , totalBytes_(0)
+    , stopAcknowledged_(false)
 {
     LOG_INFO("Created download task: " + url + " -> " + destination);
 }
 
+void DownloadTask::setStateCounts(TaskStateCounts* counts) {
+    stateCounts_ = counts;
+    if (stateCounts_) {
+        stateCounts_->add(state_.load());
+    }
+}
+
+bool DownloadTask::transition(DownloadState& expected, DownloadState to) {
+    if (!state_.compare_exchange_strong(expected, to)) {
+        return false;
+    }
+    if (stateCounts_) {
+        stateCounts_->move(expected, to);
+    }
+    return true;
+}
+
+void DownloadTask::transition(DownloadState to) {
+    DownloadState from = state_.exchange(to);
+    if (stateCounts_) {
+        stateCounts_->move(from, to);
+    }
+}
+
 void DownloadTask::start() {
+    std::lock_guard<std::mutex> lock(pauseMutex_);
     DownloadState expected = DownloadState::Queued;
-    if (state_.compare_exchange_strong(expected, DownloadState::Downloading)) {
+    if (transition(expected, DownloadState::Downloading)) {
+        stopAcknowledged_ = false;
         startTime_ = std::chrono::steady_clock::now();
         LOG_INFO("Download started: " + url_);
     } else {
@@ -53,19 +112,32 @@ void DownloadTask::start() {
 //     }
 // }
 
-void DownloadTask::resume() {
+bool DownloadTask::resume() {
+    std::lock_guard<std::mutex> lock(pauseMutex_);
     DownloadState expected = DownloadState::Paused;
-    if (state_.compare_exchange_strong(expected, DownloadState::Downloading)) {
+    if (transition(expected, DownloadState::Downloading)) {
+        stopAcknowledged_ = false;
         LOG_INFO("Download resumed: " + url_);
-    } else {
-        LOG_WARN("Cannot resume download, current state: " + stateToString(expected));
+        return true;
     }
+    LOG_WARN("Cannot resume download, current state: " + stateToString(expected));
+    return false;
+}
+
+bool DownloadTask::requeue() {
+    DownloadState expected = DownloadState::Paused;
+    if (transition(expected, DownloadState::Queued)) {
+        LOG_INFO("Download requeued: " + url_);
+        return true;
+    }
+    LOG_WARN("Cannot requeue download, current state: " + stateToString(expected));
+    return false;
 }
 
 void DownloadTask::cancel() {
     DownloadState expected = state_.load();
     while (expected != DownloadState::Completed && expected != DownloadState::Failed && expected != DownloadState::Canceled) {
-        if (state_.compare_exchange_strong(expected, DownloadState::Canceled)) {
+        if (transition(expected, DownloadState::Canceled)) {
             LOG_INFO("Download canceled: " + url_);
             return;
         }
@@ -74,7 +146,7 @@ void DownloadTask::cancel() {
 }
 
 void DownloadTask::markCompleted() {
-    state_.store(DownloadState::Completed);
+    transition(DownloadState::Completed);
     LOG_INFO("Download completed: " + url_);
 }
 
@@ -83,7 +155,7 @@ void DownloadTask::markFailed(const std::string& errorMessage) {
         std::lock_guard<std::mutex> lock(errorMutex_);
         errorMessage_ = errorMessage;
     }
-    state_.store(DownloadState::Failed);
+    transition(DownloadState::Failed);
     LOG_ERROR("Download failed: " + url_ + " Error: " + errorMessage);
 }
 
@@ -128,8 +200,12 @@ Config DownloadTask::toConfig() const {
     config.retry_count = retryCount_;
     config.timeout_seconds = timeoutSeconds_;
     config.connect_timeout_seconds = connectTimeoutSeconds_;
-    config.expected_checksum = expectedChecksum_;
+    // Checksums may carry an "algo:" prefix
+    ChecksumAlgorithm algorithm = ChecksumAlgorithm::Sha256;
+    Checksum::parse_spec(expectedChecksum_, algorithm, config.expected_checksum);
+    config.checksum_algorithm = Checksum::algorithm_name(algorithm);
     config.verify_checksum = !expectedChecksum_.empty();
+    config.segments = segments_;
 
     config.show_help = false;
     config.default_download_dir = ".";
@@ -144,26 +220,49 @@ bool DownloadTask::shouldContinue() const {
 bool DownloadTask::waitForPause(std::chrono::milliseconds timeout) {
     std::unique_lock<std::mutex> lock(pauseMutex_);
 
-    //Wait until state is Paused (or timeout)
-    bool paused = pauseConfirmed_.wait_for(lock, timeout, [this] {
-        return state_.load() == DownloadState::Paused;
+    //Wait until the worker has stopped (or timeout)
+    bool stopped = pauseConfirmed_.wait_for(lock, timeout, [this] {
+        return stopAcknowledged_;
     });
 
-    if (!paused) {
+    if (!stopped) {
         LOG_WARN("Pause timeout for: " + url_);
     }
 
-    return paused;
+    return stopped && state_.load() == DownloadState::Paused;
 }
 
-void DownloadTask::pause() {
+bool DownloadTask::pause(const std::shared_ptr<CountdownLatch>& stopped) {
+    std::lock_guard<std::mutex> lock(pauseMutex_);
     DownloadState expected = DownloadState::Downloading;
 
-    if (state_.compare_exchange_strong(expected, DownloadState::Paused)) {
-        LOG_INFO("Download paused: " + url_);
-        pauseConfirmed_.notify_all();
-    } else {
+    if (!transition(expected, DownloadState::Paused)) {
         LOG_WARN("Cannot pause download, current state: " + stateToString(expected));
+        return false;
+    }
+
+    LOG_INFO("Download pause requested: " + url_);
+    if (stopped) {
+        if (stopAcknowledged_) {
+            stopped->countDown();
+        } else {
+            stopLatch_ = stopped;
+        }
+    }
+    return true;
+}
+
+void DownloadTask::acknowledgeStop() {
+    std::shared_ptr<CountdownLatch> latch;
+    {
+        std::lock_guard<std::mutex> lock(pauseMutex_);
+        stopAcknowledged_ = true;
+        latch.swap(stopLatch_);
+    }
+
+    pauseConfirmed_.notify_all();
+    if (latch) {
+        latch->countDown();
     }
 }
 
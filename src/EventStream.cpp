@@ -0,0 +1,263 @@
+#include "EventStream.h"
+#include "DownloadTask.h"
+#include "Logger.h"
+#include "json.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <csignal>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+EventStream::EventStream(std::chrono::milliseconds progressInterval)
+    : queue_(QUEUE_CAPACITY)
+    , overflowing_(false)
+    , progressInterval_(progressInterval)
+    , fd_(-1)
+    , ownsFd_(false)
+    , running_(false)
+    , sleeping_(false)
+    , dropped_(0)
+{
+}
+
+EventStream::~EventStream() {
+    close();
+}
+
+const char* EventStream::typeName(Type type) {
+    switch (type) {
+        case Type::Queued: return "queued";
+        case Type::Started: return "started";
+        case Type::Progress: return "progress";
+        case Type::Retry: return "retry";
+        case Type::Paused: return "paused";
+        case Type::Completed: return "completed";
+        case Type::Failed: return "failed";
+        case Type::Canceled: return "canceled";
+        default: return "unknown";
+    }
+}
+
+int64_t EventStream::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool EventStream::open(const std::string& target) {
+    if (target.empty()) {
+        return false;
+    }
+
+    if (std::all_of(target.begin(), target.end(), ::isdigit)) {
+        fd_ = std::stoi(target);
+        ownsFd_ = false;
+#ifndef _WIN32
+        if (fcntl(fd_, F_GETFD) == -1) {
+            LOG_ERROR("Event stream: file descriptor " + target + " is not open");
+            fd_ = -1;
+            return false;
+        }
+#endif
+    } else {
+#ifdef _WIN32
+        fd_ = _open(target.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+#else
+        fd_ = ::open(target.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+        ownsFd_ = true;
+        if (fd_ < 0) {
+            LOG_ERROR("Event stream: could not open " + target);
+            return false;
+        }
+    }
+
+#ifndef _WIN32
+    //A reader that goes away must not kill the download with SIGPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    running_.store(true);
+    writer_ = std::thread(&EventStream::run, this);
+    return true;
+}
+
+void EventStream::setProgressSource(std::function<ProgressAggregator::Snapshot()> source) {
+    progressSource_ = std::move(source);
+}
+
+void EventStream::emit(Type type, size_t task, const std::string& url, const std::string& output,
+                       const std::string& message, int attempt) {
+    if (!running_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    //Once something spilled, later events follow it there so the stream stays in order
+    Event event{type, task, url, output, 0, 0, 0.0, attempt, message, nowMs()};
+    if (overflowing_.load(std::memory_order_acquire) || !queue_.push(event)) {
+        if (type == Type::Progress) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(overflowMutex_);
+        overflow_.push_back(std::move(event));
+        overflowing_.store(true, std::memory_order_release);
+    }
+
+    //Pairs with the fence in run(): either the writer sees this event or we see it asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wake_.notify_one();
+    }
+}
+
+void EventStream::close() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+    }
+    wake_.notify_one();
+    writer_.join();
+
+    if (ownsFd_ && fd_ >= 0) {
+#ifdef _WIN32
+        _close(fd_);
+#else
+        ::close(fd_);
+#endif
+    }
+    fd_ = -1;
+}
+
+void EventStream::run() {
+    auto lastProgress = std::chrono::steady_clock::now();
+    std::string batch;
+
+    for (;;) {
+        bool stopping = !running_.load();
+
+        Event event;
+        while (queue_.pop(event)) {
+            append(batch, event);
+        }
+
+        //Spilled events came after everything just popped
+        std::deque<Event> spilled;
+        {
+            std::lock_guard<std::mutex> lock(overflowMutex_);
+            spilled.swap(overflow_);
+            overflowing_.store(false, std::memory_order_release);
+        }
+        for (const Event& late : spilled) {
+            append(batch, late);
+        }
+
+        size_t dropped = dropped_.exchange(0);
+        if (dropped > 0) {
+            json line = {{"ts", nowMs()}, {"event", "dropped"}, {"count", dropped}};
+            batch += line.dump() + "\n";
+        }
+
+        //Progress last, so a final sample lands before the stream ends
+        auto now = std::chrono::steady_clock::now();
+        if (progressSource_ && (stopping || now - lastProgress >= progressInterval_)) {
+            writeProgress(batch);
+            lastProgress = now;
+        }
+
+        if (!batch.empty()) {
+            writeAll(batch);
+            batch.clear();
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queue_.empty() && !overflowing_.load() && running_.load()) {
+            auto next = progressSource_ ? lastProgress + progressInterval_ : now + std::chrono::seconds(1);
+            wake_.wait_until(lock, next);
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void EventStream::writeProgress(std::string& batch) {
+    ProgressAggregator::Snapshot snapshot = progressSource_();
+
+    std::unordered_map<const DownloadTask*, size_t> reported;
+    for (const ProgressAggregator::TaskProgress& task : snapshot.tasks) {
+        const DownloadTask* key = task.task.get();
+
+        auto previous = reported_.find(key);
+        bool moved = previous == reported_.end() || previous->second != task.bytesDownloaded;
+        reported[key] = task.bytesDownloaded;
+
+        //Only running tasks that moved since the last report
+        if (task.state != DownloadState::Downloading || !moved) {
+            continue;
+        }
+
+        Event event{Type::Progress, task.task->getId(), task.task->getUrl(), task.task->getDesitnation(),
+                    task.bytesDownloaded, task.totalBytes, task.bytesPerSecond, 0, "", nowMs()};
+        append(batch, event);
+    }
+    reported_.swap(reported);
+}
+
+void EventStream::append(std::string& batch, const Event& event) {
+    json line = {
+        {"ts", event.timeMs},
+        {"event", typeName(event.type)},
+        {"task", event.task},
+        {"url", event.url},
+        {"output", event.output}
+    };
+
+    if (event.type == Type::Progress) {
+        line["bytes"] = event.bytes;
+        line["total"] = event.total;
+        line["rate"] = static_cast<uint64_t>(event.rate);
+    }
+    if (event.type == Type::Retry) {
+        line["attempt"] = event.attempt;
+    }
+    if (!event.message.empty()) {
+        line["message"] = event.message;
+    }
+
+    batch += line.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+}
+
+void EventStream::writeAll(const std::string& batch) {
+    const char* data = batch.data();
+    size_t left = batch.size();
+
+    while (left > 0) {
+#ifdef _WIN32
+        int written = _write(fd_, data, static_cast<unsigned int>(left));
+#else
+        ssize_t written = ::write(fd_, data, left);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; //Reader gone, events are best effort
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+}
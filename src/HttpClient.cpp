@@ -1,24 +1,64 @@
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#ifdef __linux__
+#include <fcntl.h>
+#endif
 #include "HttpClient.h"
 #include "Config.h"
 #include "Checksum.h"
 #include "Logger.h"
+#include "TransferEngine.h"
+#include "CurlHandlePool.h"
+#include "BandwidthLimiter.h"
 
 
 CurlHttpClient::CurlHttpClient() {
     LOG_INFO("Initializing CURL HTTP Client.");
-    curl = curl_easy_init();
+    // Taken from CurlHandlePool on the thread that drives the transfer
+    curl = nullptr;
     last_dlnow = 0;
     progress_complete = false; 
+    show_progress = true;
     resume_from = 0;
+    max_retries = MAX_RETRIES;
+    timeout = 300;
+    connect_timeout = 30;
+    attempt = 0;
+    retry_delay_seconds = 0;
+    fp = nullptr;
+    should_stop = false;
+    mode = Mode::Single;
+    segment_count = 1;
+    content_length = -1;
+    accept_ranges = false;
+    header_status = 0;
+    request_headers = nullptr;
+    body_started = false;
+    out_of_space = false;
+    stream_checksum = false;
+    check_chunks = false;
+    write_offset = 0;
+    repair_round = 0;
+    session_base = 0;
+    bandwidth_flow = 0;
 }
 
 CurlHttpClient::~CurlHttpClient() {
+    if (fp) {
+        fclose(fp);
+    }
+    close_segments();
+    for (auto& segment : segments) {
+        CurlHandlePool::getInstance().release(segment->handle);
+    }
     if(curl) {
         std::cout << "Cleaning up CURL resources." << std::endl;
-        curl_easy_cleanup(curl);
+        CurlHandlePool::getInstance().release(curl);
     }
+    curl_slist_free_all(request_headers);
 }
 
 size_t CurlHttpClient::write_data(void *ptr, size_t size, size_t nmemb, FILE* stream) {
@@ -119,7 +159,17 @@ ErrorType CurlHttpClient::classify_error(CURLcode curl_error, long http_code) {
 int CurlHttpClient::progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
     CurlHttpClient* client = static_cast<CurlHttpClient*>(clientp);
 
-    if (dltotal <= 0) {
+    // Also called while connecting or stalled, so pause and cancel don't wait for body bytes
+    if (client->should_continue && !client->should_continue()) {
+        client->should_stop = true;
+        return 1;
+    }
+
+    if (client->progress_listener) {
+        client->progress_listener(client->resume_from + dlnow, dltotal > 0 ? client->resume_from + dltotal : -1);
+    }
+
+    if (dltotal <= 0 || !client->show_progress) {
         return 0;  // Continue download
     }
 
@@ -139,13 +189,54 @@ int CurlHttpClient::progress_callback(void *clientp, curl_off_t dltotal, curl_of
     curl_off_t total_downloaded = client->resume_from + dlnow;
     curl_off_t total_size = client->resume_from + dltotal;
 
+    client->render_progress(total_downloaded, total_size, dlnow);
+    client->last_dlnow = dlnow;
+    return 0;
+}
+
+int CurlHttpClient::segment_progress_callback(void *clientp, curl_off_t /*dltotal*/, curl_off_t /*dlnow*/, curl_off_t /*ultotal*/, curl_off_t /*ulnow*/) {
+    Segment* segment = static_cast<Segment*>(clientp);
+    CurlHttpClient* client = segment->client;
+
+    if (client->should_continue && !client->should_continue()) {
+        client->should_stop = true;
+        return 1;
+    }
+
+    if (client->content_length <= 0) {
+        return 0;
+    }
+
+    // Progress of the whole file: everything but what the segments still have to fetch
+    curl_off_t total_downloaded = client->content_length;
+    for (const auto& s : client->segments) {
+        total_downloaded -= s->length() - s->written;
+    }
+
+    if (client->progress_listener) {
+        client->progress_listener(total_downloaded, client->content_length);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto time_since_last = std::chrono::duration_cast<std::chrono::milliseconds>(now - client->last_time);
+
+    if (!client->show_progress || client->progress_complete || time_since_last.count() < 1000) {
+        return 0;
+    }
+
+    client->render_progress(total_downloaded, client->content_length, total_downloaded - client->session_base);
+    return 0;
+}
+
+void CurlHttpClient::render_progress(curl_off_t total_downloaded, curl_off_t total_size, curl_off_t session_bytes) {
+    auto now = std::chrono::steady_clock::now();
     double percentage = (total_downloaded * 100.0) / total_size;
 
-    auto total_elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - client->start_time);
+    auto total_elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time);
     double speed_bps = 0.0;
 
     if(total_elapsed.count() > 0){
-        speed_bps = dlnow / static_cast<double>(total_elapsed.count());
+        speed_bps = session_bytes / static_cast<double>(total_elapsed.count());
     }
     
     double speed_display = 0.0;
@@ -161,13 +252,10 @@ int CurlHttpClient::progress_callback(void *clientp, curl_off_t dltotal, curl_of
 
     int eta_seconds = 0;
     if (speed_bps > 0) {
-        curl_off_t remaining_bytes = dltotal - dlnow;
+        curl_off_t remaining_bytes = total_size - total_downloaded;
         eta_seconds = static_cast<int>(remaining_bytes / speed_bps);
     }
 
-    // auto format_bytes = [](curl_off_t bytes) -> std::string {
-    // };
-
     int bar_width = 20;
     int filled = static_cast<int>(percentage / 100.0 * bar_width);
     std::string bar = "[";
@@ -189,14 +277,12 @@ int CurlHttpClient::progress_callback(void *clientp, curl_off_t dltotal, curl_of
               << "ETA: " << eta_seconds << "s      "
               << std::flush;
 
-    client->last_time = now;
-    client->last_dlnow = dlnow;
+    last_time = now;
 
-    if(dlnow >= dltotal && !client->progress_complete){
+    if(total_downloaded >= total_size && !progress_complete){
         std::cout << std::endl;
-        client->progress_complete = true;
+        progress_complete = true;
     }
-    return 0;
 }
 
 std::string get_timestamp() {
@@ -219,183 +305,886 @@ std::string get_timestamp() {
 }
 
 
-bool CurlHttpClient::download_file(std::string& url, std::string& output_path,
-                                    int max_retries, int timeout, int connect_timeout, std::function<bool()> shouldContinue) {
-    if(!curl) {
-        return false;
-    }
+bool CurlHttpClient::prepare(const std::string& url, const std::string& output_path,
+                             int max_retries, int timeout, int connect_timeout, std::function<bool()> shouldContinue) {
+    this->url = url;
+    this->max_retries = max_retries;
+    this->timeout = timeout;
+    this->connect_timeout = connect_timeout;
+    should_continue = shouldContinue;
+    attempt = 0;
+    retry_delay_seconds = 0;
+    repair_round = 0;
 
-    std::filesystem::path final_path(output_path);
-    std::filesystem::path temp_path = final_path;
+    final_path = output_path;
+    temp_path = final_path;
     temp_path += ".part";
 
+    // Left-over ranges (an interrupted split or chunk repair) resume as segments
+    bool has_ranges = std::filesystem::exists(segment_state_path());
+    mode = (segment_count > 1 || has_ranges) ? Mode::Probe : Mode::Single;
+
     if (!ensure_dir_exists(final_path)) {
         std::cerr << "\nFailed to create directory for: " << output_path << std::endl;
         return false;
     }
 
-    for (int attempt = 0; attempt <= max_retries; attempt++) {
-        if (attempt > 0) {
-            std::string retryMsg = "Retry attempt " + std::to_string(attempt) + "/" + std::to_string(max_retries);
-            LOG_WARN(retryMsg);
+    return true;
+}
+
+bool CurlHttpClient::begin_single() {
+    if (attempt > 0) {
+        std::string retryMsg = "Retry attempt " + std::to_string(attempt) + "/" + std::to_string(max_retries);
+        LOG_WARN(retryMsg);
+    }
+
+    //resume scenario
+    curl_off_t existing_size = 0;
+    bool resuming = false;
+
+    if (std::filesystem::exists(temp_path)) {
+        existing_size = std::filesystem::file_size(temp_path);
+
+        if (existing_size > 0) {
+            resuming = true;
+            resume_from = existing_size;
+            std::cout << "\nFound partial download ("
+                      << format_bytes(existing_size)
+                      << "). Resuming..." << std::endl;
+        } else {
+            std::filesystem::remove(temp_path);
+            existing_size = 0;
         }
+    } else {
+        resume_from = 0;
+    }
 
-        CURL* head_curl = curl_easy_init();
-        if (head_curl) {
-            curl_easy_setopt(head_curl, CURLOPT_URL, url.c_str());
-            curl_easy_setopt(head_curl, CURLOPT_NOBODY, 1L);  // HEAD request
-            curl_easy_setopt(head_curl, CURLOPT_HEADER, 0L);
-            
-            CURLcode head_res = curl_easy_perform(head_curl);
-            if (head_res == CURLE_OK) {
-                curl_off_t file_size = 0;
-                curl_easy_getinfo(head_curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &file_size);
-        
-                if (file_size > 0) {
-                    // Check if we have enough disk space
-                    if (!check_disk_space(final_path, file_size)) {
-                        curl_easy_cleanup(head_curl);
-                        return false;
-                    }
-                }
-            }       
-            curl_easy_cleanup(head_curl);
+    if (!resuming) {
+        // A midstate is only valid for the prefix it was saved with
+        std::filesystem::remove(hash_state_path());
+        chunk_states.assign(chunk_states.size(), ChunkState::Unchecked);
+    }
+    write_offset = existing_size;
+    chunk_cursor.hasher.reset();
+
+    const char* file_mode = resuming ? "ab" : "wb";
+    fp = fopen(temp_path.string().c_str(), file_mode);
+    if(!fp){
+        std::cerr << "\nFailed to open file for writing: " << temp_path << std::endl;
+        return false;
+    }
+
+    // Keep the running hash in step with what is on disk. After a retry it
+    // already covers the prefix; a prefix from an earlier run starts from the
+    // saved midstate and only the bytes written after it are read back.
+    streamed_checksum.clear();
+    if (stream_checksum) {
+        uint64_t on_disk = static_cast<uint64_t>(existing_size);
+        if (stream_hash.bytes_hashed() == 0 && on_disk > 0) {
+            stream_hash.load_state(hash_state_path());
+        }
+        if (stream_hash.bytes_hashed() > on_disk) {
+            stream_hash.reset();
+        }
+        if (stream_hash.bytes_hashed() < on_disk && !stream_hash.update_from_file(temp_path, on_disk)) {
+            std::cerr << "\nFailed to hash partial download: " << temp_path << std::endl;
+            return false;
         }
+    }
+
+    should_stop = false;
+    body_started = false;
+    out_of_space = false;
+    write_ctx = { this, fp, should_continue, &should_stop };
+    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_with_check);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &write_ctx);
+
+    // Handles are driven from a multi loop on a non-main thread
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    //Progress tracking
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+
+    // Size and validators come from the GET's own headers, no HEAD needed
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+
+    if (resuming) {
+        std::string range_header = std::to_string(existing_size) + "-";
+        curl_easy_setopt(curl, CURLOPT_RANGE, range_header.c_str());
+        set_if_range(curl);
+    } else {
+        // The handle is reused across attempts, drop any range from a previous one
+        curl_easy_setopt(curl, CURLOPT_RANGE, nullptr);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    }
 
-        //resume scenario
-        curl_off_t existing_size = 0;
-        bool resuming = false;
+    // Set timeout to avoid hanging forever
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));  // 5 minutes
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, static_cast<long>(connect_timeout));  // 30 seconds to connect
 
-        if (std::filesystem::exists(temp_path)) {
-            existing_size = std::filesystem::file_size(temp_path);
-
-            if (existing_size > 0) {
-                resuming = true;
-                resume_from = existing_size;
-                std::cout << "\nFound partial download (" 
-                          << format_bytes(existing_size)
-                          << "). Resuming..." << std::endl; 
+    /**
+     * Reset attributes for new downloads
+     */
+    start_time = std::chrono::steady_clock::now();
+    last_time = start_time;
+    last_checkpoint = start_time;
+    progress_complete = false;
+
+    ready_handles.push_back(curl);
+    return true;
+}
+
+TransferStatus CurlHttpClient::finish_single(CURLcode res) {
+    long response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+
+    if (stream_checksum) {
+        save_hash_state();
+    }
+    fclose(fp);
+    fp = nullptr;
+
+    if (should_stop) {
+        LOG_WARN("Download paused by user request: " + url);
+        return TransferStatus::Stopped;
+    }
+
+    if (out_of_space) {
+        // Keep the .part, the download can resume once space is freed
+        return TransferStatus::Failed;
+    }
+
+    ErrorType error_type = classify_error(res, response_code);
+
+    if(error_type == ErrorType::Success){
+        std::cout << std::endl;  // Ensure we're on a new line
+        if (check_chunks) {
+            TransferStatus status = verify_chunks();
+            if (status != TransferStatus::Succeeded) {
+                return status;
+            }
+        }
+        if (stream_checksum) {
+            streamed_checksum = stream_hash.hex_digest();
+        }
+        std::filesystem::remove(hash_state_path());
+        try
+        {
+            std::filesystem::rename(temp_path, final_path);
+            std::cout << "Download complete: " << final_path << std::endl;
+            return TransferStatus::Succeeded;
+        }
+        catch(const std::filesystem::filesystem_error& e)
+        {
+            std::cerr << "Error renaming file: " << e.what() << std::endl;
+            std::cerr << "Downloaded file is at: " << temp_path << std::endl;
+            return TransferStatus::Failed;
+        }
+    }
+    if (error_type == ErrorType::Permanent) {
+        std::cout << std::endl;
+        if (res == CURLE_OK) {
+            std::cerr << "\nHTTP Error " << response_code << ": ";
+            if (response_code == 404) {
+                std::cerr << "File not found";
+            }
+            else if (response_code == 403) {
+                std::cerr << "Access forbidden";
+            }
+            else if (response_code == 401) {
+                std::cerr << "Authentication required";
             } else {
-                std::filesystem::remove(temp_path);
-                existing_size = 0;
+                std::cerr << "Client error";
             }
+        std::cerr << std::endl;
         } else {
-            resume_from = 0;
+            std::cerr << "\nError: " << curl_easy_strerror(res) << std::endl;
         }
+        std::filesystem::remove(temp_path);
+        std::filesystem::remove(hash_state_path());
+        return TransferStatus::Failed;
+    }
 
-        const char* file_mode = resuming ? "ab" : "wb";
-        FILE *fp = fopen(temp_path.string().c_str(), file_mode);
-        if(!fp){
-            std::cerr << "\nFailed to open file for writing: " << temp_path << std::endl;
+    // Transient error
+    std::cout << std::endl;
+
+    std::cerr << "[" << get_timestamp() << "] ";
+    if (res == CURLE_OK) {
+        std::cerr << "Server error (HTTP " << response_code << ")";
+    } else {
+        std::cerr << "Network error: " << curl_easy_strerror(res);
+    }
+
+    std::cerr << std::endl;
+
+    if (attempt < max_retries) {
+        retry_delay_seconds = 1 << attempt;  // Exponential backoff: 2^attempt
+        std::cout << "Waiting " << retry_delay_seconds << " second(s) before retry..." << std::endl;
+        attempt++;
+        if (retry_listener) {
+            retry_listener(attempt, res == CURLE_OK ? "HTTP " + std::to_string(response_code) : curl_easy_strerror(res));
+        }
+        return TransferStatus::RetryLater;
+    }
+
+    std::cerr << "\nDownload failed after " << max_retries << " retries." << std::endl;
+    std::filesystem::remove(temp_path);
+    std::filesystem::remove(hash_state_path());
+    return TransferStatus::Failed;
+}
+
+bool CurlHttpClient::begin_attempt() {
+    ready_handles.clear();
+
+    if (!curl) {
+        curl = CurlHandlePool::getInstance().acquire(url);
+        if (!curl) {
             return false;
         }
+    }
+
+    switch (mode) {
+    case Mode::Probe:
+        begin_probe();
+        return true;
+    case Mode::Single:
+        return begin_single();
+    case Mode::Segmented:
+        return begin_segmented();
+    }
+    return false;
+}
 
-        bool shouldStop = false;
-        WriteContext writeCtx = { fp, shouldContinue, &shouldStop };
-        // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data_with_check);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &writeCtx);
+std::vector<CURL*> CurlHttpClient::take_ready_handles() {
+    std::vector<CURL*> handles;
+    handles.swap(ready_handles);
+    return handles;
+}
 
-        //Progress tracking
-        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
-        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+TransferStatus CurlHttpClient::finish_handle(CURL* easy, CURLcode res) {
+    if (mode == Mode::Probe) {
+        return finish_probe(res);
+    }
 
-        if (resuming) {
-            std::string range_header = std::to_string(existing_size) + "-";
-            curl_easy_setopt(curl, CURLOPT_RANGE, range_header.c_str());
+    if (mode == Mode::Segmented) {
+        for (auto& segment : segments) {
+            if (segment->handle == easy) {
+                return finish_segment(*segment, res);
+            }
         }
+        return TransferStatus::Running;
+    }
 
-        // Set timeout to avoid hanging forever
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));  // 5 minutes
-        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, static_cast<long>(connect_timeout));  // 30 seconds to connect
-            
-        /**
-         * Reset attributes for new downloads
-         */
-        start_time = std::chrono::steady_clock::now();
-        last_time = start_time;
-        progress_complete = false; 
+    return finish_single(res);
+}
 
+bool CurlHttpClient::retry_handle(CURL* easy) {
+    if (mode != Mode::Segmented) {
+        return begin_attempt();
+    }
 
-        CURLcode res = curl_easy_perform(curl);
-        long response_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    for (auto& segment : segments) {
+        if (segment->handle == easy) {
+            return arm_segment(*segment);
+        }
+    }
+    return false;
+}
 
-        if (shouldStop) {
-            LOG_WARN("Download paused by user request: " + url);
+size_t CurlHttpClient::header_callback(char *buffer, size_t size, size_t nitems, void* userdata) {
+    CurlHttpClient* client = static_cast<CurlHttpClient*>(userdata);
+    size_t length = size * nitems;
+
+    std::string line(buffer, length);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+        line.pop_back();
+    }
+
+    // Status line: a new response starts (redirect, 100-continue, ...)
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        size_t space = line.find(' ');
+        client->header_status = space == std::string::npos ? 0 : std::atol(line.c_str() + space + 1);
+        client->pending_etag.clear();
+        client->pending_last_modified.clear();
+        client->accept_ranges = false;
+        return length;
+    }
+
+    // End of headers: validators only count if they describe the resource
+    if (line.empty()) {
+        if (client->header_status == 200 || client->header_status == 206) {
+            client->etag = client->pending_etag;
+            client->last_modified = client->pending_last_modified;
+        }
+        return length;
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+        return length;
+    }
+
+    std::string name = Checksum::to_lowercase(line.substr(0, colon));
+    size_t value_start = line.find_first_not_of(" \t", colon + 1);
+    std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+
+    if (name == "etag") {
+        client->pending_etag = value;
+    } else if (name == "last-modified") {
+        client->pending_last_modified = value;
+    } else if (name == "accept-ranges") {
+        client->accept_ranges = Checksum::to_lowercase(value).find("bytes") != std::string::npos;
+    }
+
+    return length;
+}
+
+void CurlHttpClient::set_if_range(CURL* handle) {
+    // If the file changed since the bytes we have, the server answers 200 with the new body
+    curl_slist_free_all(request_headers);
+    request_headers = nullptr;
+
+    if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        request_headers = curl_slist_append(nullptr, ("If-Range: " + etag).c_str());
+    } else if (!last_modified.empty()) {
+        request_headers = curl_slist_append(nullptr, ("If-Range: " + last_modified).c_str());
+    }
+
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request_headers);
+}
+
+void CurlHttpClient::reserve_space(FILE* file, curl_off_t offset, curl_off_t length) {
+#ifdef __linux__
+    // Reserve the blocks without changing the file size, so resume still
+    // measures progress by size. Best effort: not every filesystem supports it.
+    fflush(file);
+    fallocate(fileno(file), FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(length));
+#endif
+}
+
+bool CurlHttpClient::throttle(CURL* handle, size_t bytes) {
+    BandwidthLimiter& limiter = BandwidthLimiter::getInstance();
+    if (!pause_listener || (!limiter.enabled() && bandwidth_flow == 0)) {
+        return false;
+    }
+
+    // Over the cap: curl keeps the data and delivers it again once unpaused
+    std::chrono::nanoseconds wait = bandwidth_flow != 0 ? limiter.acquire(bytes, bandwidth_flow) : limiter.acquire(bytes);
+    if (wait.count() <= 0) {
+        return false;
+    }
+    pause_listener(handle, std::chrono::steady_clock::now() + std::max<std::chrono::nanoseconds>(wait, std::chrono::milliseconds(1)));
+    return true;
+}
+
+bool CurlHttpClient::on_first_body_bytes() {
+    body_started = true;
+
+    long response_code = 0;
+    curl_off_t body_length = -1;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &body_length);
+
+    if (resume_from > 0 && response_code == 200) {
+        // Range ignored or If-Range failed: this body is the whole (new) file
+        LOG_WARN("Server sent the full file, restarting from the beginning: " + url);
+        fp = freopen(temp_path.string().c_str(), "wb", fp);
+        write_ctx.file = fp;
+        resume_from = 0;
+        write_offset = 0;
+        stream_hash.reset();
+        std::filesystem::remove(hash_state_path());
+        chunk_states.assign(chunk_states.size(), ChunkState::Unchecked);
+        if (!fp) {
+            std::cerr << "\nFailed to reopen file for writing: " << temp_path << std::endl;
             return false;
         }
+    }
 
+    if (body_length > 0) {
+        content_length = resume_from + body_length;
 
-        fclose(fp);
+        if (!check_disk_space(final_path, body_length)) {
+            out_of_space = true;
+            return false;
+        }
+        reserve_space(fp, resume_from, body_length);
+    }
+
+    return true;
+}
+
+void CurlHttpClient::begin_probe() {
+    // The split needs the size up front, so this is the one place a HEAD is sent
+    accept_ranges = false;
+    content_length = -1;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, static_cast<long>(connect_timeout));
+
+    ready_handles.push_back(curl);
+}
+
+TransferStatus CurlHttpClient::finish_probe(CURLcode res) {
+    long response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+    // Put the handle back into GET mode for whichever path comes next
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+
+    mode = Mode::Single;
+
+    if (should_stop) {
+        LOG_WARN("Download paused by user request: " + url);
+        return TransferStatus::Stopped;
+    }
+
+    bool has_ranges = std::filesystem::exists(segment_state_path());
+
+    if (classify_error(res, response_code) != ErrorType::Success || content_length <= 0) {
+        LOG_INFO("Size unknown, downloading over a single connection: " + url);
+    } else if (!check_disk_space(final_path, content_length)) {
+        return TransferStatus::Failed;
+    } else if (!accept_ranges) {
+        LOG_INFO("Server does not accept ranges, downloading over a single connection: " + url);
+    } else if (has_ranges && load_segment_state()) {
+        // Left-over ranges (a chunk repair of a small file) resume whatever the size;
+        // begin_segmented loads them again
+        segments.clear();
+        mode = Mode::Segmented;
+    } else if (content_length / MIN_SEGMENT_SIZE >= 2) {
+        mode = Mode::Segmented;
+    }
+
+    // The ranges describe a preallocated, partly filled .part: it is no prefix
+    // for a single connection to resume from, so start over
+    if (mode == Mode::Single && has_ranges) {
+        LOG_WARN("Saved ranges can't be resumed, downloading again: " + url);
+        std::filesystem::remove(temp_path);
+        std::filesystem::remove(segment_state_path());
+        std::filesystem::remove(hash_state_path());
+    }
+
+    if (!begin_attempt()) {
+        return TransferStatus::Failed;
+    }
+    return TransferStatus::Running;
+}
+
+void CurlHttpClient::remove_partial(const std::filesystem::path& output_path) {
+    std::filesystem::path part = output_path;
+    part += ".part";
+
+    std::error_code ec;
+    for (const char* suffix : {"", ".segments", ".hash"}) {
+        std::filesystem::path path = part;
+        path += suffix;
+        std::filesystem::remove(path, ec);
+    }
+}
+
+std::filesystem::path CurlHttpClient::segment_state_path() const {
+    std::filesystem::path state_path = temp_path;
+    state_path += ".segments";
+    return state_path;
+}
+
+std::filesystem::path CurlHttpClient::hash_state_path() const {
+    std::filesystem::path path = temp_path;
+    path += ".hash";
+    return path;
+}
 
-        ErrorType error_type = classify_error(res, response_code);
+void CurlHttpClient::save_hash_state() {
+    last_checkpoint = std::chrono::steady_clock::now();
 
-        if(error_type == ErrorType::Success){
-            std::cout << std::endl;  // Ensure we're on a new line
-            try
-            {
-                std::filesystem::rename(temp_path, final_path);
-                std::cout << "Download complete: " << final_path << std::endl;
-                return true;
+    // The midstate must never cover bytes that are not yet in the file
+    if (fp) {
+        fflush(fp);
+    }
+    stream_hash.save_state(hash_state_path());
+}
+
+bool CurlHttpClient::load_segment_state() {
+    std::ifstream state(segment_state_path());
+    if (!state.is_open() || !std::filesystem::exists(temp_path)) {
+        return false;
+    }
+
+    curl_off_t total = 0;
+    std::string validator;
+    state >> total;
+    state.ignore(1);
+    std::getline(state, validator);
+
+    // A different size or validator means the file changed since the ranges were fetched
+    bool changed = !validator.empty() && validator != (etag.empty() ? last_modified : etag);
+    if (!state || changed || total != content_length || std::filesystem::file_size(temp_path) != static_cast<uintmax_t>(total)) {
+        LOG_WARN("Discarding stale segment state for: " + temp_path.string());
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Segment>> loaded;
+    curl_off_t start = 0;
+    curl_off_t end = 0;
+    curl_off_t written = 0;
+    while (state >> start >> end >> written) {
+        auto segment = std::make_unique<Segment>();
+        segment->start = start;
+        segment->end = end;
+        segment->written = written;
+        loaded.push_back(std::move(segment));
+    }
+
+    if (loaded.empty()) {
+        return false;
+    }
+
+    segments.swap(loaded);
+    return true;
+}
+
+void CurlHttpClient::save_segment_state() {
+    // Data must reach the file before the state file claims it
+    for (auto& segment : segments) {
+        if (segment->file) {
+            fflush(segment->file);
+        }
+    }
+    last_checkpoint = std::chrono::steady_clock::now();
+
+    std::vector<std::array<curl_off_t, 3>> ranges;
+    for (const auto& segment : segments) {
+        ranges.push_back({segment->start, segment->end, segment->written});
+    }
+    write_segment_state(ranges);
+}
+
+void CurlHttpClient::write_segment_state(const std::vector<std::array<curl_off_t, 3>>& ranges) {
+    std::filesystem::path state_path = segment_state_path();
+    std::filesystem::path tmp_state = state_path;
+    tmp_state += ".tmp";
+
+    {
+        std::ofstream state(tmp_state, std::ios::trunc);
+        if (!state.is_open()) {
+            LOG_WARN("Could not write segment state: " + state_path.string());
+            return;
+        }
+
+        state << content_length << "\n";
+        state << (etag.empty() ? last_modified : etag) << "\n";
+        for (const auto& range : ranges) {
+            state << range[0] << " " << range[1] << " " << range[2] << "\n";
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_state, state_path, ec);
+}
+
+bool CurlHttpClient::begin_segmented() {
+    for (auto& segment : segments) {
+        CurlHandlePool::getInstance().release(segment->handle);
+    }
+    segments.clear();
+
+    // Ranges land out of order, a streaming midstate cannot follow them
+    std::filesystem::remove(hash_state_path());
+
+    if (load_segment_state()) {
+        std::cout << "\nResuming segmented download (" << segments.size() << " segments)" << std::endl;
+    } else {
+        // A single-connection .part is a valid prefix of the file, keep it
+        curl_off_t existing = 0;
+        if (std::filesystem::exists(temp_path)) {
+            existing = static_cast<curl_off_t>(std::filesystem::file_size(temp_path));
+            if (existing > content_length) {
+                existing = 0;
             }
-            catch(const std::filesystem::filesystem_error& e)
-            {
-                std::cerr << "Error renaming file: " << e.what() << std::endl;
-                std::cerr << "Downloaded file is at: " << temp_path << std::endl;
-                return false;
-            }    
-        }
-        if (error_type == ErrorType::Permanent) {
-            std::cout << std::endl; 
-            if (res == CURLE_OK) {
-                std::cerr << "\nHTTP Error " << response_code << ": ";
-                if (response_code == 404) {
-                    std::cerr << "File not found";
-                } 
-                else if (response_code == 403) {
-                    std::cerr << "Access forbidden";
-                } 
-                else if (response_code == 401) {
-                    std::cerr << "Authentication required";
-                } else {
-                    std::cerr << "Client error";
-                }
-            std::cerr << std::endl;
-            } else {
-                std::cerr << "\nError: " << curl_easy_strerror(res) << std::endl;
+        }
+
+        // A repair restart can get here with a small file whose saved ranges were lost
+        curl_off_t count = std::max<curl_off_t>(1, std::min<curl_off_t>(segment_count, content_length / MIN_SEGMENT_SIZE));
+        curl_off_t segment_size = content_length / count;
+
+        if (check_chunks) {
+            // Segments that start on a chunk boundary hash every chunk as it lands
+            curl_off_t chunk_size = static_cast<curl_off_t>(chunk_manifest.chunk_size());
+            segment_size = (segment_size + chunk_size - 1) / chunk_size * chunk_size;
+            count = (content_length + segment_size - 1) / segment_size;
+        }
+
+        for (curl_off_t i = 0; i < count; ++i) {
+            auto segment = std::make_unique<Segment>();
+            segment->start = i * segment_size;
+            segment->end = (i == count - 1) ? content_length - 1 : segment->start + segment_size - 1;
+            segment->written = std::clamp<curl_off_t>(existing - segment->start, 0, segment->length());
+            segments.push_back(std::move(segment));
+        }
+
+        // Size the output file once, every segment then writes in place
+        try {
+            if (!std::filesystem::exists(temp_path)) {
+                std::ofstream(temp_path, std::ios::binary);
             }
-            std::filesystem::remove(temp_path);
+            std::filesystem::resize_file(temp_path, static_cast<uintmax_t>(content_length));
+        } catch (const std::filesystem::filesystem_error& e) {
+            std::cerr << "\nFailed to preallocate " << temp_path << ": " << e.what() << std::endl;
             return false;
         }
 
-        if (error_type == ErrorType::Transient) {
-            std::cout << std::endl;
+        std::cout << "\nDownloading " << format_bytes(content_length) << " in "
+                  << segments.size() << " segments" << std::endl;
+    }
 
-            std::cerr << "[" << get_timestamp() << "] ";
-            if (res == CURLE_OK) {
-                std::cerr << "Server error (HTTP " << response_code << ")";
-            } else {
-                std::cerr << "Network error: " << curl_easy_strerror(res);
-            }
+    start_time = std::chrono::steady_clock::now();
+    last_time = start_time;
+    progress_complete = false;
+    should_stop = false;
+    session_base = content_length;
 
-            std::cerr << std::endl;
+    // Every range is conditional on the file still being the one the probe saw
+    set_if_range(curl);
 
-            if (attempt < max_retries) {
-                int delay = 1 << attempt;  // Exponential backoff: 2^attempt
-                std::cout << "Waiting " << delay << " second(s) before retry..." << std::endl;
-                std::this_thread::sleep_for(std::chrono::seconds(delay));
+    for (auto& segment : segments) {
+        segment->client = this;
+        segment->handle = CurlHandlePool::getInstance().acquire(url);
+        segment->file = nullptr;
+        segment->attempt = 0;
+        segment->done = segment->written == segment->length();
+        session_base -= segment->length() - segment->written;
+
+        if (!segment->handle) {
+            return false;
+        }
+        if (!segment->done && !arm_segment(*segment)) {
+            return false;
+        }
+    }
+
+    save_segment_state();
+    return true;
+}
+
+bool CurlHttpClient::arm_segment(Segment& segment) {
+    if (!segment.file) {
+        segment.file = fopen(temp_path.string().c_str(), "r+b");
+        if (!segment.file) {
+            std::cerr << "\nFailed to open file for writing: " << temp_path << std::endl;
+            return false;
+        }
+    }
+
+    // Each segment keeps its own FILE*, positioned where its range continues
+    curl_off_t offset = segment.start + segment.written;
+#ifdef _WIN32
+    int seek_result = _fseeki64(segment.file, offset, SEEK_SET);
+#else
+    int seek_result = fseeko(segment.file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+    if (seek_result != 0) {
+        std::cerr << "\nFailed to seek in " << temp_path << std::endl;
+        return false;
+    }
+
+    segment.range_checked = false;
+    segment.range_ignored = false;
+    segment.chunks.hasher.reset();
+
+    std::string range = std::to_string(offset) + "-" + std::to_string(segment.end);
+
+    CURL* handle = segment.handle;
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(handle, CURLOPT_RANGE, range.c_str());
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request_headers);
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_segment);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &segment);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, segment_progress_callback);
+    curl_easy_setopt(handle, CURLOPT_XFERINFODATA, &segment);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT, static_cast<long>(timeout));
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, static_cast<long>(connect_timeout));
+
+    ready_handles.push_back(handle);
+    return true;
+}
+
+size_t CurlHttpClient::write_segment(void *ptr, size_t size, size_t nmemb, void* userdata) {
+    Segment* segment = static_cast<Segment*>(userdata);
+    CurlHttpClient* client = segment->client;
+
+    if (client->should_continue && !client->should_continue()) {
+        client->should_stop = true;
+        return 0;
+    }
+
+    // A 200 here means the whole body is coming, which would land at the wrong offset
+    if (!segment->range_checked) {
+        long response_code = 0;
+        curl_easy_getinfo(segment->handle, CURLINFO_RESPONSE_CODE, &response_code);
+        if (response_code != 206) {
+            segment->range_ignored = true;
+            return 0;
+        }
+        segment->range_checked = true;
+    }
+
+    size_t bytes = size * nmemb;
+    if (static_cast<curl_off_t>(bytes) > segment->length() - segment->written) {
+        segment->range_ignored = true;
+        return 0;
+    }
+
+    if (client->throttle(segment->handle, bytes)) {
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
+    size_t written = fwrite(ptr, 1, bytes, segment->file);
+    if (client->check_chunks) {
+        client->hash_chunks(segment->chunks, segment->start + segment->written, ptr, written);
+    }
+    segment->written += static_cast<curl_off_t>(written);
+
+    if (std::chrono::steady_clock::now() - client->last_checkpoint >= CHECKPOINT_INTERVAL) {
+        client->save_segment_state();
+    }
+
+    return written;
+}
+
+TransferStatus CurlHttpClient::finish_segment(Segment& segment, CURLcode res) {
+    long response_code = 0;
+    curl_easy_getinfo(segment.handle, CURLINFO_RESPONSE_CODE, &response_code);
+
+    if (should_stop) {
+        // Keep .part and its state file so the next attempt resumes every segment
+        save_segment_state();
+        close_segments();
+        LOG_WARN("Download paused by user request: " + url);
+        return TransferStatus::Stopped;
+    }
+
+    if (segment.range_ignored) {
+        LOG_WARN("Server ignored range request, falling back to a single connection: " + url);
+        close_segments();
+        std::filesystem::remove(temp_path);
+        std::filesystem::remove(segment_state_path());
+        mode = Mode::Single;
+        return TransferStatus::Restart;
+    }
+
+    ErrorType error_type = classify_error(res, response_code);
+
+    if (error_type == ErrorType::Success && segment.written == segment.length()) {
+        segment.done = true;
+        fclose(segment.file);
+        segment.file = nullptr;
+
+        for (const auto& s : segments) {
+            if (!s->done) {
+                save_segment_state();
+                return TransferStatus::Running;
             }
-            // continue to next iteration
-            continue;
+        }
+
+        std::cout << std::endl;
+        close_segments();
+        if (check_chunks) {
+            TransferStatus status = verify_chunks();
+            if (status != TransferStatus::Succeeded) {
+                return status;
+            }
+        }
+        std::filesystem::remove(segment_state_path());
+        try
+        {
+            std::filesystem::rename(temp_path, final_path);
+            std::cout << "Download complete: " << final_path << std::endl;
+            return TransferStatus::Succeeded;
+        }
+        catch(const std::filesystem::filesystem_error& e)
+        {
+            std::cerr << "Error renaming file: " << e.what() << std::endl;
+            std::cerr << "Downloaded file is at: " << temp_path << std::endl;
+            return TransferStatus::Failed;
         }
     }
 
-    std::cerr << "\nDownload failed after " << max_retries << " retries." << std::endl;
+    if (error_type == ErrorType::Permanent) {
+        std::cerr << "\nSegment " << segment.start << "-" << segment.end << " failed: ";
+        if (res == CURLE_OK) {
+            std::cerr << "HTTP Error " << response_code << std::endl;
+        } else {
+            std::cerr << curl_easy_strerror(res) << std::endl;
+        }
+        close_segments();
+        std::filesystem::remove(temp_path);
+        std::filesystem::remove(segment_state_path());
+        return TransferStatus::Failed;
+    }
+
+    // Transient error (or a short body): retry just this range from where it stopped
+    save_segment_state();
+
+    if (segment.attempt < max_retries) {
+        retry_delay_seconds = 1 << segment.attempt;
+        segment.attempt++;
+        LOG_WARN("Segment " + std::to_string(segment.start) + "-" + std::to_string(segment.end) +
+                 " interrupted (" + std::string(curl_easy_strerror(res)) + "), retry " +
+                 std::to_string(segment.attempt) + "/" + std::to_string(max_retries) +
+                 " in " + std::to_string(retry_delay_seconds) + "s");
+        if (retry_listener) {
+            retry_listener(segment.attempt, curl_easy_strerror(res));
+        }
+        return TransferStatus::RetryLater;
+    }
+
+    std::cerr << "\nSegment " << segment.start << "-" << segment.end
+              << " failed after " << max_retries << " retries." << std::endl;
+    close_segments();
     std::filesystem::remove(temp_path);
-    return false;
+    std::filesystem::remove(segment_state_path());
+    return TransferStatus::Failed;
+}
+
+void CurlHttpClient::close_segments() {
+    for (auto& segment : segments) {
+        if (segment->file) {
+            fclose(segment->file);
+            segment->file = nullptr;
+        }
+    }
+}
+
+bool CurlHttpClient::download_file(std::string& url, std::string& output_path,
+                                    int max_retries, int timeout, int connect_timeout, std::function<bool()> shouldContinue) {
+    if (!prepare(url, output_path, max_retries, timeout, connect_timeout, shouldContinue)) {
+        return false;
+    }
+
+    // Drive the transfer (and its retries) on this thread
+    bool success = false;
+    TransferEngine engine;
+    engine.submit(this, [&success](bool result) {
+        success = result;
+    });
+    engine.run();
+
+    return success;
 }
 
 std::string CurlHttpClient::format_bytes(curl_off_t bytes){
@@ -408,11 +1197,145 @@ std::string CurlHttpClient::format_bytes(curl_off_t bytes){
         }
         return std::to_string(bytes) + "B";
 }
+ChecksumAlgorithm CurlHttpClient::checksum_algorithm(const Config& config) {
+    ChecksumAlgorithm algorithm = ChecksumAlgorithm::Sha256;
+    Checksum::parse_algorithm(config.checksum_algorithm, algorithm);
+    return algorithm;
+}
+
+void CurlHttpClient::set_stream_checksum(const Config& config) {
+    stream_checksum = config.verify_checksum;
+
+    ChecksumAlgorithm algorithm = checksum_algorithm(config);
+    if (stream_hash.algorithm() != algorithm) {
+        stream_hash.reset(algorithm);
+    }
+}
+
+bool CurlHttpClient::set_chunk_manifest(const Config& config) {
+    check_chunks = false;
+    if (config.chunk_manifest.empty()) {
+        return true;
+    }
+
+    if (!chunk_manifest.load(config.chunk_manifest)) {
+        return false;
+    }
+    chunk_states.assign(chunk_manifest.chunk_count(), ChunkState::Unchecked);
+    check_chunks = true;
+    return true;
+}
+
+void CurlHttpClient::hash_chunks(ChunkCursor& cursor, curl_off_t offset, const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    uint64_t position = static_cast<uint64_t>(offset);
+
+    while (length > 0 && position < chunk_manifest.size()) {
+        size_t index = chunk_manifest.chunk_at(position);
+        uint64_t chunk_start = chunk_manifest.chunk_offset(index);
+        uint64_t chunk_length = chunk_manifest.chunk_length(index);
+
+        if (!cursor.hasher || cursor.index != index || chunk_start + cursor.filled != position) {
+            // Picked up mid-chunk (resume): that chunk is read back once the file is complete
+            cursor.hasher = Checksum::create_hasher(chunk_manifest.algorithm());
+            cursor.index = index;
+            cursor.filled = position - chunk_start;
+            cursor.whole = cursor.filled == 0;
+        }
+
+        size_t take = static_cast<size_t>(std::min<uint64_t>(length, chunk_length - cursor.filled));
+        if (cursor.whole) {
+            cursor.hasher->update(bytes, take);
+        }
+        cursor.filled += take;
+        position += take;
+        bytes += take;
+        length -= take;
+
+        if (cursor.filled == chunk_length) {
+            if (cursor.whole) {
+                bool good = chunk_manifest.matches(index, cursor.hasher->hex_digest());
+                chunk_states[index] = good ? ChunkState::Good : ChunkState::Bad;
+                if (!good) {
+                    LOG_WARN("Chunk " + std::to_string(index) + " failed verification, it will be re-fetched: " + url);
+                }
+            }
+            cursor.hasher.reset();
+        }
+    }
+}
+
+TransferStatus CurlHttpClient::verify_chunks() {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(temp_path, ec);
+    if (ec || size != chunk_manifest.size()) {
+        std::cerr << "\nDownloaded " << (ec ? 0 : size) << " bytes, but the chunk manifest describes "
+                  << chunk_manifest.size() << std::endl;
+        std::filesystem::remove(temp_path);
+        std::filesystem::remove(hash_state_path());
+        return TransferStatus::Failed;
+    }
+
+    // Chunks that did not land whole in this run (resumed, or split across segments) are read back
+    size_t read_back = 0;
+    curl_off_t corrupt_bytes = 0;
+    std::vector<std::array<curl_off_t, 3>> corrupt;
+    for (size_t i = 0; i < chunk_manifest.chunk_count(); ++i) {
+        if (chunk_states[i] == ChunkState::Unchecked) {
+            chunk_states[i] = chunk_manifest.verify_chunk(temp_path, i) ? ChunkState::Good : ChunkState::Bad;
+            read_back++;
+        }
+        if (chunk_states[i] != ChunkState::Bad) {
+            continue;
+        }
+
+        chunk_states[i] = ChunkState::Unchecked;
+        curl_off_t start = static_cast<curl_off_t>(chunk_manifest.chunk_offset(i));
+        curl_off_t end = start + static_cast<curl_off_t>(chunk_manifest.chunk_length(i)) - 1;
+        if (!corrupt.empty() && corrupt.back()[1] + 1 == start) {
+            corrupt.back()[1] = end;
+        } else {
+            corrupt.push_back({start, end, 0});
+        }
+        corrupt_bytes += end - start + 1;
+    }
+
+    if (corrupt.empty()) {
+        LOG_INFO("All " + std::to_string(chunk_manifest.chunk_count()) + " chunks verified (" +
+                 std::to_string(read_back) + " read back): " + url);
+        return TransferStatus::Succeeded;
+    }
+
+    // Good chunks stay, the corrupt ranges are recorded as unfinished segments
+    content_length = static_cast<curl_off_t>(size);
+    write_segment_state(corrupt);
+    streamed_checksum.clear();
+    stream_hash.reset();
+    std::filesystem::remove(hash_state_path());
+
+    if (repair_round >= max_retries) {
+        std::cerr << "\n" << format_bytes(corrupt_bytes) << " still corrupt after " << max_retries
+                  << " repair rounds, run again to re-fetch only those ranges: " << temp_path << std::endl;
+        return TransferStatus::Failed;
+    }
+
+    repair_round++;
+    std::cout << corrupt.size() << " corrupt range(s), re-fetching " << format_bytes(corrupt_bytes)
+              << " (repair " << repair_round << "/" << max_retries << ")" << std::endl;
+    mode = Mode::Segmented;
+    return TransferStatus::Restart;
+}
+
 bool CurlHttpClient::download_and_verify(const Config& config, std::function<bool()> shouldContinue) {
     // First, perform the download
     std::string url = config.url;
     std::string output_path = config.output_path;
     
+    set_segments(config.segments);
+    set_stream_checksum(config);
+    if (!set_chunk_manifest(config)) {
+        return false;
+    }
     bool success = download_file(url, output_path,
                                            config.retry_count,
                                            config.timeout_seconds,
@@ -425,47 +1348,51 @@ bool CurlHttpClient::download_and_verify(const Config& config, std::function<boo
     
     // If checksum verification requested, verify it
     if (config.verify_checksum) {
-        std::cout << "\nVerifying checksum..." << std::endl;
-        
-        std::filesystem::path file_path(output_path);
+        return verify_download(config, get_streamed_checksum());
+    }
+    
+    return true;  // No verification requested, download succeeded
+}
+
+bool CurlHttpClient::verify_download(const Config& config, const std::string& actual_hash) {
+    std::cout << "\nVerifying checksum..." << std::endl;
+
+    std::filesystem::path file_path(config.output_path);
+
+    // Hash once: the same value is used for the comparison and the report
+    std::string actual = actual_hash.empty() ? Checksum::compute(file_path, checksum_algorithm(config)) : actual_hash;
+    bool checksum_valid = !actual.empty() &&
+        Checksum::to_lowercase(actual) == Checksum::to_lowercase(config.expected_checksum);
+    
+    if (checksum_valid) {
+        std::cout << "✓ Checksum verified successfully!" << std::endl;
+        return true;
+    } else {
+        std::cerr << "✗ Checksum verification failed!" << std::endl;
+        std::cerr << "Expected: " << config.expected_checksum << std::endl;
+        std::cerr << "Actual:   " << actual << std::endl;
         
-        bool checksum_valid = Checksum::verify_sha256(file_path, config.expected_checksum);
+        // Quarantine the corrupted file
+        std::filesystem::path quarantine_dir("./quarantine");
         
-        if (checksum_valid) {
-            std::cout << "✓ Checksum verified successfully!" << std::endl;
-            return true;
-        } else {
-            std::cerr << "✗ Checksum verification failed!" << std::endl;
-            std::cerr << "Expected: " << config.expected_checksum << std::endl;
-            
-            // Compute actual hash to show user
-            std::string actual = Checksum::compute_sha256(file_path);
-            std::cerr << "Actual:   " << actual << std::endl;
-            
-            // Quarantine the corrupted file
-            std::filesystem::path quarantine_dir("./quarantine");
-            
-            try {
-                // Create quarantine directory if it doesn't exist
-                if (!std::filesystem::exists(quarantine_dir)) {
-                    std::filesystem::create_directories(quarantine_dir);
-                    std::cout << "Created quarantine directory" << std::endl;
-                }
-                
-                // Move file to quarantine
-                std::filesystem::path quarantine_path = quarantine_dir / file_path.filename();
-                std::filesystem::rename(file_path, quarantine_path);
-                
-                std::cerr << "File moved to quarantine: " << quarantine_path << std::endl;
-            } catch (const std::filesystem::filesystem_error& e) {
-                std::cerr << "Error quarantining file: " << e.what() << std::endl;
+        try {
+            // Create quarantine directory if it doesn't exist
+            if (!std::filesystem::exists(quarantine_dir)) {
+                std::filesystem::create_directories(quarantine_dir);
+                std::cout << "Created quarantine directory" << std::endl;
             }
             
-            return false;
+            // Move file to quarantine
+            std::filesystem::path quarantine_path = quarantine_dir / file_path.filename();
+            std::filesystem::rename(file_path, quarantine_path);
+            
+            std::cerr << "File moved to quarantine: " << quarantine_path << std::endl;
+        } catch (const std::filesystem::filesystem_error& e) {
+            std::cerr << "Error quarantining file: " << e.what() << std::endl;
         }
+        
+        return false;
     }
-    
-    return true;  // No verification requested, download succeeded
 }
 
 size_t CurlHttpClient::write_data_with_check(void *ptr, size_t size, size_t nmemb, void* userdata) {
@@ -476,7 +1403,28 @@ size_t CurlHttpClient::write_data_with_check(void *ptr, size_t size, size_t nmem
         return 0; // Returning 0 will signal libcurl to abort
     }
 
+    // Size is known once the body starts: check space before writing anything
+    if (!ctx->client->body_started && !ctx->client->on_first_body_bytes()) {
+        return 0;
+    }
+
+    if (ctx->client->throttle(ctx->client->curl, size * nmemb)) {
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
     size_t written = fwrite(ptr, size, nmemb, ctx->file);
+    if (ctx->client->check_chunks) {
+        ctx->client->hash_chunks(ctx->client->chunk_cursor, ctx->client->write_offset, ptr, written * size);
+    }
+    ctx->client->write_offset += static_cast<curl_off_t>(written * size);
+
+    if (ctx->client->stream_checksum) {
+        ctx->client->stream_hash.update(ptr, written * size);
+
+        if (std::chrono::steady_clock::now() - ctx->client->last_checkpoint >= CHECKPOINT_INTERVAL) {
+            ctx->client->save_hash_state();
+        }
+    }
     return written;
 }
 
@@ -0,0 +1,270 @@
+#include "ManifestVerifier.h"
+#include "Logger.h"
+#include "Sha256Lanes.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#else
+#include <cctype>
+#endif
+
+// Upper bound on reader threads, however many devices the manifest spans
+static const size_t MAX_READERS = 64;
+
+ManifestVerifier::ManifestVerifier(size_t maxPerDevice)
+    : useLanes_(Sha256Lanes::preferred())
+    , maxPerDevice_(std::max<size_t>(1, maxPerDevice))
+    , malformed_(0)
+    , passed_(0)
+    , mismatched_(0)
+    , unreadable_(0)
+    , bytes_(0)
+{
+}
+
+void ManifestVerifier::statEntry(Entry& entry) {
+    entry.device = 0;
+    entry.size = UINT64_MAX;
+
+#ifndef _WIN32
+    struct stat st;
+    if (stat(entry.path.c_str(), &st) == 0) {
+        entry.device = static_cast<uint64_t>(st.st_dev);
+        entry.size = static_cast<uint64_t>(st.st_size);
+    }
+#else
+    // Drive letter stands in for the device
+    std::string root = entry.path.root_name().string();
+    if (!root.empty()) {
+        entry.device = static_cast<uint64_t>(std::toupper(static_cast<unsigned char>(root[0])));
+    }
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(entry.path, ec);
+    if (!ec) {
+        entry.size = size;
+    }
+#endif
+}
+
+bool ManifestVerifier::algorithmFromName(const std::filesystem::path& manifest, ChecksumAlgorithm& algorithm) {
+    static const std::pair<const char*, ChecksumAlgorithm> PREFIXES[] = {
+        {"b3sums", ChecksumAlgorithm::Blake3},
+        {"blake3sums", ChecksumAlgorithm::Blake3},
+        {"sha512sums", ChecksumAlgorithm::Sha512},
+        {"sha256sums", ChecksumAlgorithm::Sha256},
+        {"sha1sums", ChecksumAlgorithm::Sha1},
+    };
+
+    std::string name = Checksum::to_lowercase(manifest.filename().string());
+    for (const auto& prefix : PREFIXES) {
+        if (name.compare(0, std::strlen(prefix.first), prefix.first) == 0) {
+            algorithm = prefix.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ManifestVerifier::load(const std::filesystem::path& manifest, const std::string& algorithm) {
+    //Without either, bare digests fall back to their length (64 reads as SHA-256)
+    ChecksumAlgorithm fixed = ChecksumAlgorithm::Sha256;
+    bool hasFixed = false;
+    if (!algorithm.empty()) {
+        hasFixed = Checksum::parse_algorithm(algorithm, fixed);
+        if (!hasFixed) {
+            std::cerr << "Error: unknown checksum algorithm: " << algorithm << std::endl;
+            return false;
+        }
+    } else {
+        hasFixed = algorithmFromName(manifest, fixed);
+    }
+
+    std::ifstream input(manifest);
+    if (!input.is_open()) {
+        std::cerr << "Error: could not open manifest: " << manifest << std::endl;
+        return false;
+    }
+
+    std::filesystem::path base = manifest.parent_path();
+    std::string line;
+    size_t lineNumber = 0;
+
+    while (std::getline(input, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        // "<hex>  <name>" (text mode) or "<hex> *<name>" (binary mode)
+        size_t space = line.find(' ');
+        if (space == std::string::npos || space + 2 > line.size()) {
+            std::cerr << manifest.string() << ":" << lineNumber << ": malformed line" << std::endl;
+            ++malformed_;
+            continue;
+        }
+
+        Entry entry;
+        std::string digest = line.substr(0, space);
+        Checksum::parse_spec(digest, entry.algorithm, entry.expected);
+        if (hasFixed && digest.find(':') == std::string::npos) {
+            entry.algorithm = fixed;
+        }
+        entry.name = line.substr(space + 2);
+
+        if (entry.expected.size() != Checksum::digest_hex_length(entry.algorithm) || entry.name.empty()) {
+            std::cerr << manifest.string() << ":" << lineNumber << ": malformed line" << std::endl;
+            ++malformed_;
+            continue;
+        }
+
+        entry.path = entry.name;
+        if (entry.path.is_relative()) {
+            entry.path = base / entry.path;
+        }
+        statEntry(entry);
+        entries_.push_back(std::move(entry));
+    }
+
+    return true;
+}
+
+void ManifestVerifier::drain(const std::vector<const Entry*>& files, std::atomic<size_t>& cursor) {
+    std::vector<const Entry*> batch;
+    size_t next;
+
+    while ((next = cursor.fetch_add(1)) < files.size()) {
+        const Entry* entry = files[next];
+
+        if (useLanes_ && entry->algorithm == ChecksumAlgorithm::Sha256 && entry->size <= SMALL_FILE_LIMIT) {
+            batch.push_back(entry);
+            if (batch.size() == Sha256Lanes::LANES) {
+                verifyBatch(batch);
+                batch.clear();
+            }
+            continue;
+        }
+
+        verifyEntry(*entry);
+    }
+
+    if (!batch.empty()) {
+        verifyBatch(batch);
+    }
+}
+
+void ManifestVerifier::verifyEntry(const Entry& entry) {
+    std::string actual = entry.size == UINT64_MAX ? "" : Checksum::compute(entry.path, entry.algorithm);
+    report(entry, actual);
+}
+
+void ManifestVerifier::verifyBatch(const std::vector<const Entry*>& batch) {
+    std::vector<std::vector<uint8_t>> contents;
+    std::vector<const Entry*> readable;
+
+    for (const Entry* entry : batch) {
+        std::ifstream file(entry->path, std::ios::binary);
+        std::vector<uint8_t> content(static_cast<size_t>(entry->size));
+        if (!file.is_open() || !file.read(reinterpret_cast<char*>(content.data()), content.size())) {
+            report(*entry, "");
+            continue;
+        }
+        contents.push_back(std::move(content));
+        readable.push_back(entry);
+    }
+
+    const uint8_t* data[Sha256Lanes::LANES];
+    size_t lengths[Sha256Lanes::LANES];
+    uint8_t digests[Sha256Lanes::LANES][Sha256Lanes::DIGEST_LEN];
+    for (size_t i = 0; i < readable.size(); ++i) {
+        data[i] = contents[i].data();
+        lengths[i] = contents[i].size();
+    }
+
+    Sha256Lanes::hash(data, lengths, readable.size(), digests);
+
+    for (size_t i = 0; i < readable.size(); ++i) {
+        report(*readable[i], Checksum::bytes_to_hex(digests[i], Sha256Lanes::DIGEST_LEN));
+    }
+}
+
+void ManifestVerifier::report(const Entry& entry, const std::string& actual) {
+    if (actual.empty()) {
+        unreadable_.fetch_add(1);
+        std::lock_guard<std::mutex> lock(outputMutex_);
+        std::cout << entry.name << ": FAILED open or read" << std::endl;
+        return;
+    }
+
+    bytes_.fetch_add(entry.size);
+
+    if (Checksum::to_lowercase(actual) != Checksum::to_lowercase(entry.expected)) {
+        mismatched_.fetch_add(1);
+        std::lock_guard<std::mutex> lock(outputMutex_);
+        std::cout << entry.name << ": FAILED" << std::endl;
+        return;
+    }
+
+    passed_.fetch_add(1);
+}
+
+ManifestVerifier::Summary ManifestVerifier::run() {
+    auto start = std::chrono::steady_clock::now();
+
+    //One work list per device, each drained by a bounded number of readers
+    std::map<uint64_t, std::vector<const Entry*>> byDevice;
+    for (const Entry& entry : entries_) {
+        byDevice[entry.device].push_back(&entry);
+    }
+
+    size_t readers = 0;
+    for (const auto& device : byDevice) {
+        readers += std::min(maxPerDevice_, device.second.size());
+    }
+
+    if (readers > 0) {
+        ThreadPool pool(std::min(readers, MAX_READERS));
+        std::vector<std::future<void>> lanes;
+        std::vector<std::unique_ptr<std::atomic<size_t>>> cursors;
+
+        for (const auto& device : byDevice) {
+            const std::vector<const Entry*>* files = &device.second;
+            cursors.push_back(std::make_unique<std::atomic<size_t>>(0));
+            std::atomic<size_t>* cursor = cursors.back().get();
+
+            size_t deviceReaders = std::min(maxPerDevice_, files->size());
+            for (size_t i = 0; i < deviceReaders; ++i) {
+                lanes.push_back(pool.enqueue([this, files, cursor] {
+                    drain(*files, *cursor);
+                }));
+            }
+        }
+
+        for (auto& lane : lanes) {
+            lane.get();
+        }
+    }
+
+    Summary summary;
+    summary.files = entries_.size();
+    summary.passed = passed_.load();
+    summary.mismatched = mismatched_.load();
+    summary.unreadable = unreadable_.load();
+    summary.malformed = malformed_;
+    summary.bytes = bytes_.load();
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LOG_INFO("Manifest verified: " + std::to_string(summary.passed) + "/" + std::to_string(summary.files) + " files OK");
+    return summary;
+}
@@ -0,0 +1,71 @@
+#include "ProgressAggregator.h"
+#include <cmath>
+
+ProgressAggregator::ProgressAggregator(std::chrono::milliseconds smoothing)
+    : smoothing_(smoothing)
+{
+}
+
+ProgressAggregator::Snapshot ProgressAggregator::sample(const std::vector<std::shared_ptr<DownloadTask>>& tasks) {
+    return sample(tasks, std::chrono::steady_clock::now());
+}
+
+ProgressAggregator::Snapshot ProgressAggregator::sample(const std::vector<std::shared_ptr<DownloadTask>>& tasks,
+                                                        std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Snapshot snapshot{};
+    snapshot.tasks.reserve(tasks.size());
+
+    std::unordered_map<const DownloadTask*, Rate> rates;
+    rates.reserve(tasks.size());
+
+    for (const auto& task : tasks) {
+        TaskProgress progress{};
+        progress.task = task;
+        progress.state = task->getState();
+        progress.bytesDownloaded = task->getBytesDownloaded();
+        progress.totalBytes = task->getTotalBytes();
+        progress.etaSeconds = -1;
+
+        Rate rate{progress.bytesDownloaded, now, 0.0};
+        auto previous = rates_.find(task.get());
+        if (previous != rates_.end()) {
+            rate.bytesPerSecond = previous->second.bytesPerSecond;
+            double elapsed = std::chrono::duration<double>(now - previous->second.lastTime).count();
+
+            if (progress.state != DownloadState::Downloading) {
+                rate.bytesPerSecond = 0.0;
+            } else if (progress.bytesDownloaded < previous->second.lastBytes) {
+                //Transfer restarted from an earlier offset, start measuring again
+                rate.bytesPerSecond = 0.0;
+            } else if (elapsed > 0) {
+                double instant = (progress.bytesDownloaded - previous->second.lastBytes) / elapsed;
+                double weight = 1.0 - std::exp(-elapsed / smoothing_.count());
+                rate.bytesPerSecond += weight * (instant - rate.bytesPerSecond);
+            } else {
+                rate = previous->second;
+            }
+        }
+        rates[task.get()] = rate;
+        progress.bytesPerSecond = rate.bytesPerSecond;
+
+        if (progress.totalBytes > 0 && progress.bytesPerSecond > 0 && progress.bytesDownloaded <= progress.totalBytes) {
+            progress.etaSeconds = (progress.totalBytes - progress.bytesDownloaded) / progress.bytesPerSecond;
+        }
+
+        snapshot.bytesDownloaded += progress.bytesDownloaded;
+        if (progress.totalBytes > 0) {
+            snapshot.totalBytes += progress.totalBytes;
+        }
+        snapshot.bytesPerSecond += progress.bytesPerSecond;
+        if (progress.state == DownloadState::Downloading) {
+            snapshot.active++;
+        }
+        snapshot.tasks.push_back(progress);
+    }
+
+    //Only tasks still listed keep a history
+    rates_.swap(rates);
+    return snapshot;
+}
@@ -0,0 +1,302 @@
+#include "ProgressDashboard.h"
+#include "DownloadManagerClass.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int BAR_WIDTH = 20;
+const size_t NAME_WIDTH = 24;
+
+std::string formatBytes(double bytes) {
+    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    int unit = 0;
+    while (bytes >= 1024 && unit < 4) {
+        bytes /= 1024;
+        unit++;
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+    return out.str();
+}
+
+std::string formatRate(double bytesPerSecond) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    if (bytesPerSecond >= 1024 * 1024) {
+        out << bytesPerSecond / (1024 * 1024) << " MB/s";
+    } else {
+        out << bytesPerSecond / 1024 << " KB/s";
+    }
+    return out.str();
+}
+
+std::string formatEta(double seconds) {
+    if (seconds < 0) {
+        return "ETA --";
+    }
+    long total = static_cast<long>(seconds + 0.5);
+    std::ostringstream out;
+    out << "ETA ";
+    if (total >= 3600) {
+        out << total / 3600 << "h" << std::setw(2) << std::setfill('0') << (total % 3600) / 60 << "m";
+    } else if (total >= 60) {
+        out << total / 60 << "m" << std::setw(2) << std::setfill('0') << total % 60 << "s";
+    } else {
+        out << total << "s";
+    }
+    return out.str();
+}
+
+std::string bar(size_t done, size_t total) {
+    if (total == 0) {
+        return "[" + std::string(BAR_WIDTH / 2 - 1, ' ') + "??" + std::string(BAR_WIDTH / 2 - 1, ' ') + "]";
+    }
+    int filled = static_cast<int>(std::min<double>(1.0, static_cast<double>(done) / total) * BAR_WIDTH);
+    std::string text = "[";
+    for (int i = 0; i < BAR_WIDTH; ++i) {
+        text += i < filled ? '=' : (i == filled ? '>' : ' ');
+    }
+    return text + "]";
+}
+
+std::string percent(size_t done, size_t total) {
+    if (total == 0) {
+        return "   --%";
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << std::setw(5)
+        << std::min<double>(100.0, done * 100.0 / total) << "%";
+    return out.str();
+}
+
+// Keep rows one column short of the width, a wrapped row would break the redraw
+std::string fit(const std::string& line, size_t width) {
+    return line.size() < width ? line : line.substr(0, width - 1);
+}
+
+} // namespace
+
+std::string ProgressDashboard::CaptureBuffer::takeLines() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t end = text_.rfind('\n');
+    if (end == std::string::npos) {
+        return "";
+    }
+    std::string lines = text_.substr(0, end + 1);
+    text_.erase(0, end + 1);
+    return lines;
+}
+
+std::string ProgressDashboard::CaptureBuffer::takeAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string text;
+    text.swap(text_);
+    return text;
+}
+
+ProgressDashboard::CaptureBuffer::int_type ProgressDashboard::CaptureBuffer::overflow(int_type ch) {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        text_.push_back(traits_type::to_char_type(ch));
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize ProgressDashboard::CaptureBuffer::xsputn(const char* data, std::streamsize count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    text_.append(data, static_cast<size_t>(count));
+    return count;
+}
+
+ProgressDashboard::ProgressDashboard(DownloadManager& manager, std::chrono::milliseconds interval)
+    : manager_(manager)
+    , interval_(interval)
+    , running_(false)
+    , stdout_(nullptr)
+    , stderr_(nullptr)
+{
+}
+
+ProgressDashboard::~ProgressDashboard() {
+    stop();
+}
+
+bool ProgressDashboard::isTerminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return isatty(fileno(stdout)) != 0;
+#endif
+}
+
+void ProgressDashboard::terminalSize(size_t& width, size_t& height) {
+    width = 80;
+    height = 24;
+#ifndef _WIN32
+    struct winsize size;
+    if (ioctl(fileno(stdout), TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0) {
+        width = size.ws_col;
+        height = size.ws_row;
+    }
+#endif
+}
+
+void ProgressDashboard::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    stdout_ = std::cout.rdbuf(&capture_);
+    stderr_ = std::cerr.rdbuf(&capture_);
+    drawn_.clear();
+
+    running_ = true;
+    thread_ = std::thread(&ProgressDashboard::run, this);
+}
+
+void ProgressDashboard::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    wake_.notify_all();
+    thread_.join();
+
+    renderFrame(true);
+    std::cout.rdbuf(stdout_);
+    std::cerr.rdbuf(stderr_);
+}
+
+void ProgressDashboard::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        lock.unlock();
+        renderFrame(false);
+        lock.lock();
+        wake_.wait_for(lock, interval_, [this] { return !running_; });
+    }
+}
+
+void ProgressDashboard::renderFrame(bool final) {
+    ProgressAggregator::Snapshot snapshot = manager_.getProgress();
+
+    size_t width = 0;
+    size_t height = 0;
+    terminalSize(width, height);
+
+    std::vector<std::string> lines = buildLines(snapshot, width, height);
+    std::string captured = final ? capture_.takeAll() : capture_.takeLines();
+
+    if (captured.empty() && lines == drawn_) {
+        return;
+    }
+
+    //Back to the first dashboard row
+    std::string frame;
+    if (!drawn_.empty()) {
+        frame += "\r\033[" + std::to_string(drawn_.size()) + "A";
+    }
+
+    //Captured output scrolls up above the dashboard, which is then drawn in full
+    if (!captured.empty()) {
+        frame += "\033[J" + captured;
+        if (captured.back() != '\n') {
+            frame += '\n';
+        }
+        drawn_.clear();
+    }
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (i < drawn_.size() && drawn_[i] == lines[i]) {
+            frame += '\n';
+        } else {
+            frame += "\033[2K" + lines[i] + '\n';
+        }
+    }
+    if (lines.size() < drawn_.size()) {
+        frame += "\033[J";
+    }
+    drawn_.swap(lines);
+
+    stdout_->sputn(frame.data(), static_cast<std::streamsize>(frame.size()));
+    stdout_->pubsync();
+}
+
+std::vector<std::string> ProgressDashboard::buildLines(const ProgressAggregator::Snapshot& snapshot,
+                                                       size_t width, size_t height) const {
+    //The snapshot only lists started tasks, the rest come from the counters
+    size_t queued = manager_.getStateCount(DownloadState::Queued);
+    size_t done = manager_.getStateCount(DownloadState::Completed);
+    size_t failed = manager_.getStateCount(DownloadState::Failed) + manager_.getStateCount(DownloadState::Canceled);
+    std::vector<const ProgressAggregator::TaskProgress*> rows;
+
+    for (const auto& task : snapshot.tasks) {
+        if (task.state == DownloadState::Downloading || task.state == DownloadState::Paused) {
+            rows.push_back(&task);
+        }
+    }
+
+    double eta = -1;
+    if (snapshot.totalBytes > snapshot.bytesDownloaded && snapshot.bytesPerSecond > 0) {
+        eta = (snapshot.totalBytes - snapshot.bytesDownloaded) / snapshot.bytesPerSecond;
+    }
+
+    std::vector<std::string> lines;
+    std::ostringstream total;
+    total << std::left << std::setw(NAME_WIDTH) << "Total" << " "
+          << bar(snapshot.bytesDownloaded, snapshot.totalBytes) << " "
+          << percent(snapshot.bytesDownloaded, snapshot.totalBytes) << "  "
+          << formatBytes(snapshot.bytesDownloaded) << " / " << formatBytes(snapshot.totalBytes) << "  "
+          << formatRate(snapshot.bytesPerSecond) << "  " << formatEta(eta) << "  | "
+          << snapshot.active << " active, " << queued << " queued, " << done << " done, " << failed << " failed";
+    lines.push_back(fit(total.str(), width));
+
+    //Leave a spare terminal row for the cursor
+    size_t room = height > 2 ? height - 2 : 1;
+    size_t shown = rows.size() > room ? room - 1 : rows.size();
+
+    for (size_t i = 0; i < shown; ++i) {
+        const ProgressAggregator::TaskProgress& task = *rows[i];
+
+        std::string name = std::filesystem::path(task.task->getDesitnation()).filename().string();
+        if (name.size() > NAME_WIDTH) {
+            name = name.substr(0, NAME_WIDTH - 3) + "...";
+        }
+
+        std::ostringstream row;
+        row << std::left << std::setw(NAME_WIDTH) << name << " "
+            << bar(task.bytesDownloaded, task.totalBytes) << " "
+            << percent(task.bytesDownloaded, task.totalBytes) << "  "
+            << formatBytes(task.bytesDownloaded) << " / "
+            << (task.totalBytes > 0 ? formatBytes(task.totalBytes) : std::string("?")) << "  ";
+        if (task.state == DownloadState::Paused) {
+            row << "paused";
+        } else {
+            row << formatRate(task.bytesPerSecond) << "  " << formatEta(task.etaSeconds);
+        }
+        lines.push_back(fit(row.str(), width));
+    }
+
+    if (shown < rows.size()) {
+        lines.push_back(fit("... " + std::to_string(rows.size() - shown) + " more running", width));
+    }
+
+    return lines;
+}
@@ -0,0 +1,90 @@
+#include "RunQueue.h"
+
+RunQueue::RunQueue(size_t maxPerHost)
+    : maxPerHost_(maxPerHost)
+    , nextSeq_(0)
+    , size_(0)
+{
+}
+
+void RunQueue::setMaxPerHost(size_t maxPerHost) {
+    maxPerHost_ = maxPerHost;
+}
+
+void RunQueue::unlink(HostMap::iterator host) {
+    if (!host->second.ready.empty()) {
+        order_.erase(Key{host->second.active, host->second.ready.front().first, &host->first});
+    }
+}
+
+void RunQueue::link(HostMap::iterator host) {
+    if (!host->second.ready.empty()) {
+        order_.insert(Key{host->second.active, host->second.ready.front().first, &host->first});
+    } else if (host->second.active == 0) {
+        hosts_.erase(host);
+    }
+}
+
+void RunQueue::push(std::shared_ptr<DownloadTask> task) {
+    auto host = hosts_.emplace(task->getHost(), Host()).first;
+    unlink(host);
+    host->second.ready.emplace_back(nextSeq_++, std::move(task));
+    size_++;
+    link(host);
+}
+
+std::shared_ptr<DownloadTask> RunQueue::pop() {
+    while (!order_.empty()) {
+        const Key& first = *order_.begin();
+
+        //Sorted by active count: if the least busy host is full, so is every other
+        if (maxPerHost_ > 0 && std::get<0>(first) >= maxPerHost_) {
+            return nullptr;
+        }
+
+        auto host = hosts_.find(*std::get<2>(first));
+        unlink(host);
+        std::shared_ptr<DownloadTask> task = std::move(host->second.ready.front().second);
+        host->second.ready.pop_front();
+        size_--;
+
+        //Paused, canceled or started elsewhere since it was queued
+        if (task->getState() != DownloadState::Queued) {
+            link(host);
+            continue;
+        }
+
+        host->second.active++;
+        link(host);
+        return task;
+    }
+
+    return nullptr;
+}
+
+bool RunQueue::hasSlot(const std::string& host) const {
+    if (maxPerHost_ == 0) {
+        return true;
+    }
+
+    auto it = hosts_.find(host);
+    return it == hosts_.end() || it->second.active < maxPerHost_;
+}
+
+void RunQueue::claim(const std::string& host) {
+    auto it = hosts_.emplace(host, Host()).first;
+    unlink(it);
+    it->second.active++;
+    link(it);
+}
+
+void RunQueue::release(const std::string& host) {
+    auto it = hosts_.find(host);
+    if (it == hosts_.end() || it->second.active == 0) {
+        return;
+    }
+
+    unlink(it);
+    it->second.active--;
+    link(it);
+}
@@ -0,0 +1,195 @@
+#include "Sha256Lanes.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+#if !defined(__GNUC__)
+#include <openssl/sha.h>
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const size_t LANES = Sha256Lanes::LANES;
+static const size_t BLOCK_LEN = 64;
+
+static inline uint32_t load_be32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+           static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+}
+
+// Padding of one message: its last partial block, 0x80, zeros and the bit
+// length, which takes one or two blocks
+struct Tail {
+    uint8_t bytes[2 * BLOCK_LEN];
+    size_t full_blocks; // blocks read straight from the message
+    size_t blocks;      // total blocks including padding
+};
+
+static void make_tail(const uint8_t* data, size_t length, Tail& tail) {
+    tail.full_blocks = length / BLOCK_LEN;
+    size_t rest = length % BLOCK_LEN;
+    size_t tail_blocks = rest + 9 <= BLOCK_LEN ? 1 : 2;
+    tail.blocks = tail.full_blocks + tail_blocks;
+
+    std::memset(tail.bytes, 0, sizeof(tail.bytes));
+    if (rest > 0) {
+        std::memcpy(tail.bytes, data + tail.full_blocks * BLOCK_LEN, rest);
+    }
+    tail.bytes[rest] = 0x80;
+
+    uint64_t bits = static_cast<uint64_t>(length) * 8;
+    uint8_t* end = tail.bytes + tail_blocks * BLOCK_LEN;
+    for (int i = 1; i <= 8; i++) {
+        end[-i] = static_cast<uint8_t>(bits >> (8 * (i - 1)));
+    }
+}
+
+// Dispatch like the other bundled kernels: an AVX2 build and a baseline one
+#if defined(__GNUC__)
+#if defined(__x86_64__) && defined(__linux__) && !defined(__clang__)
+#define LANES_DISPATCH __attribute__((target_clones("avx2", "default")))
+#else
+#define LANES_DISPATCH
+#endif
+
+typedef uint32_t lanes_u32 __attribute__((vector_size(4 * LANES)));
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+LANES_DISPATCH
+static void compress_lanes(uint32_t state[8][LANES], const uint8_t* const blocks[LANES], const lanes_u32& active) {
+    lanes_u32 w[16];
+    for (int i = 0; i < 16; i++) {
+        uint32_t words[LANES];
+        for (size_t l = 0; l < LANES; l++) {
+            words[l] = load_be32(blocks[l] + 4 * i);
+        }
+        std::memcpy(&w[i], words, sizeof(words));
+    }
+
+    lanes_u32 s[8];
+    std::memcpy(s, state, sizeof(s));
+    lanes_u32 a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int t = 0; t < 64; t++) {
+        lanes_u32 wt;
+        if (t < 16) {
+            wt = w[t];
+        } else {
+            lanes_u32 w15 = w[(t - 15) & 15];
+            lanes_u32 w2 = w[(t - 2) & 15];
+            lanes_u32 s0 = ROTR(w15, 7) ^ ROTR(w15, 18) ^ (w15 >> 3);
+            lanes_u32 s1 = ROTR(w2, 17) ^ ROTR(w2, 19) ^ (w2 >> 10);
+            wt = w[t & 15] + s0 + w[(t - 7) & 15] + s1;
+            w[t & 15] = wt;
+        }
+
+        lanes_u32 t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + wt;
+        lanes_u32 t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    // Lanes whose message has no block left keep their state
+    lanes_u32 out[8] = {a, b, c, d, e, f, g, h};
+    for (int i = 0; i < 8; i++) {
+        s[i] += out[i] & active;
+    }
+    std::memcpy(state, s, sizeof(s));
+}
+#endif
+
+void Sha256Lanes::hash(const uint8_t* const data[], const size_t lengths[], size_t count,
+                       uint8_t digests[][DIGEST_LEN]) {
+    count = std::min(count, LANES);
+
+#if defined(__GNUC__)
+    Tail tails[LANES];
+    size_t max_blocks = 0;
+    for (size_t l = 0; l < count; l++) {
+        make_tail(data[l], lengths[l], tails[l]);
+        max_blocks = std::max(max_blocks, tails[l].blocks);
+    }
+
+    uint32_t state[8][LANES];
+    for (int i = 0; i < 8; i++) {
+        for (size_t l = 0; l < LANES; l++) {
+            state[i][l] = H0[i];
+        }
+    }
+
+    static const uint8_t idle_block[BLOCK_LEN] = {};
+
+    for (size_t b = 0; b < max_blocks; b++) {
+        const uint8_t* blocks[LANES];
+        uint32_t mask[LANES];
+        for (size_t l = 0; l < LANES; l++) {
+            if (l >= count || b >= tails[l].blocks) {
+                blocks[l] = idle_block;
+                mask[l] = 0;
+            } else if (b < tails[l].full_blocks) {
+                blocks[l] = data[l] + b * BLOCK_LEN;
+                mask[l] = ~0u;
+            } else {
+                blocks[l] = tails[l].bytes + (b - tails[l].full_blocks) * BLOCK_LEN;
+                mask[l] = ~0u;
+            }
+        }
+
+        lanes_u32 active;
+        std::memcpy(&active, mask, sizeof(mask));
+        compress_lanes(state, blocks, active);
+    }
+
+    for (size_t l = 0; l < count; l++) {
+        for (int i = 0; i < 8; i++) {
+            uint32_t v = state[i][l];
+            digests[l][4 * i] = static_cast<uint8_t>(v >> 24);
+            digests[l][4 * i + 1] = static_cast<uint8_t>(v >> 16);
+            digests[l][4 * i + 2] = static_cast<uint8_t>(v >> 8);
+            digests[l][4 * i + 3] = static_cast<uint8_t>(v);
+        }
+    }
+#else
+    // No vector extensions: one message at a time
+    for (size_t l = 0; l < count; l++) {
+        SHA256(data[l], lengths[l], digests[l]);
+    }
+#endif
+}
+
+bool Sha256Lanes::preferred() {
+#if defined(__x86_64__) && defined(__GNUC__)
+    // With SHA-NI a single stream through OpenSSL is faster than 8 AVX2 lanes
+    static const bool preferred = [] {
+        unsigned int eax, ebx, ecx, edx;
+        bool sha_ni = __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29));
+        return !sha_ni && __builtin_cpu_supports("avx2");
+    }();
+    return preferred;
+#else
+    return false;
+#endif
+}
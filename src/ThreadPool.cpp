@@ -1,68 +1,238 @@
 #include "ThreadPool.h"
 #include "Logger.h"
 
-ThreadPool::ThreadPool(size_t numThreads) : stop_(false) {
+namespace {
+
+//Worker the calling thread runs, so tasks can enqueue onto their own deque
+struct CurrentWorker {
+    const void* pool = nullptr;
+    size_t index = 0;
+};
+
+thread_local CurrentWorker current;
+
+uint64_t nextRandom(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+}
+
+ThreadPool::ThreadPool(size_t numThreads)
+    : injection_(INJECTION_CAPACITY)
+    , overflowSize_(0)
+    , sleepers_(0)
+    , wakeups_(0)
+    , stop_(false)
+{
     LOG_INFO("Creating ThreadPool with " + std::to_string(numThreads) + " threads");
-    
-    // Create worker threads
+
+    //All deques exist before any worker may try to steal from them
     for (size_t i = 0; i < numThreads; ++i) {
-        workers_.emplace_back([this, i] {
-            // Worker loop
-            LOG_DEBUG("Worker thread " + std::to_string(i) + " started");
-            
-            while (true) {
-                std::function<void()> task;
-                
-                {
-                    // Wait for task or stop signal
-                    std::unique_lock<std::mutex> lock(queueMutex_);
-                    
-                    // Wait until: (task available) OR (stop flag set)
-                    condition_.wait(lock, [this] {
-                        return stop_ || !tasks_.empty();
-                    });
-                    
-                    // Exit if stopping and no more tasks
-                    if (stop_ && tasks_.empty()) {
-                        LOG_DEBUG("Worker thread " + std::to_string(i) + " exiting");
-                        return;
-                    }
-                    
-                    // Get task from queue
-                    task = std::move(tasks_.front());
-                    tasks_.pop();
-                }
-                
-                // Execute task (outside the lock!)
-                try {
-                    task();
-                } catch (const std::exception& e) {
-                    LOG_ERROR("Task threw exception: " + std::string(e.what()));
-                } catch (...) {
-                    LOG_ERROR("Task threw unknown exception");
-                }
-            }
-        });
+        queues_.push_back(std::make_unique<Worker>());
+        queues_.back()->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+    }
+
+    for (size_t i = 0; i < numThreads; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
     }
 }
 
 ThreadPool::~ThreadPool() {
     LOG_INFO("Shutting down ThreadPool");
-    
+
+    stop_.store(true, std::memory_order_seq_cst);
     {
-        std::unique_lock<std::mutex> lock(queueMutex_);
-        stop_ = true;
+        std::lock_guard<std::mutex> lock(parkMutex_);
+        wakeups_++;
     }
-    
+
     // Wake all threads
     condition_.notify_all();
-    
+
     // Wait for all threads to finish
     for (std::thread& worker : workers_) {
         if (worker.joinable()) {
             worker.join();
         }
     }
-    
+
+    //Jobs that slipped in while the workers were leaving still run
+    for (auto& queue : queues_) {
+        Job* job;
+        while (queue->deque.pop(job)) {
+            run(job);
+        }
+    }
+    while (Job* job = takeInjected()) {
+        run(job);
+    }
+
     LOG_INFO("ThreadPool shutdown complete");
-}
\ No newline at end of file
+}
+
+void ThreadPool::submit(Job fn) {
+    if (stop_.load(std::memory_order_acquire)) {
+        throw std::runtime_error("Cannot enqueue on stopped ThreadPool");
+    }
+
+    Job* job = new Job(std::move(fn));
+
+    if (current.pool == this) {
+        queues_[current.index]->deque.push(job);
+    } else if (!injection_.push(job)) {
+        std::lock_guard<std::mutex> lock(overflowMutex_);
+        overflow_.push_back(job);
+        overflowSize_.fetch_add(1, std::memory_order_release);
+    }
+
+    wakeOne();
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    LOG_DEBUG("Worker thread " + std::to_string(index) + " started");
+
+    current.pool = this;
+    current.index = index;
+    Worker& self = *queues_[index];
+    int idleRounds = 0;
+
+    while (true) {
+        if (Job* job = findJob(self)) {
+            run(job);
+            idleRounds = 0;
+            continue;
+        }
+
+        // Exit if stopping and no more tasks
+        if (stop_.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        //Spin a little before sleeping: bursts of small tasks arrive faster
+        //than a park/unpark round trip
+        if (++idleRounds < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        park();
+        idleRounds = 0;
+    }
+
+    current.pool = nullptr;
+    LOG_DEBUG("Worker thread " + std::to_string(index) + " exiting");
+}
+
+ThreadPool::Job* ThreadPool::findJob(Worker& self) {
+    Job* job;
+    if (self.deque.pop(job)) {
+        return job;
+    }
+
+    if ((job = takeInjected())) {
+        return job;
+    }
+
+    return stealJob(self);
+}
+
+ThreadPool::Job* ThreadPool::stealJob(Worker& self) {
+    size_t count = queues_.size();
+    if (count < 2) {
+        return nullptr;
+    }
+
+    //One pass over every other worker, starting at a random victim
+    size_t start = nextRandom(self.rng) % count;
+    for (size_t i = 0; i < count; ++i) {
+        Worker& victim = *queues_[(start + i) % count];
+        Job* job;
+        if (&victim != &self && victim.deque.steal(job)) {
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+ThreadPool::Job* ThreadPool::takeInjected() {
+    Job* job;
+    if (injection_.pop(job)) {
+        return job;
+    }
+
+    if (overflowSize_.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(overflowMutex_);
+    if (overflow_.empty()) {
+        return nullptr;
+    }
+
+    job = overflow_.front();
+    overflow_.pop_front();
+    overflowSize_.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+bool ThreadPool::hasWork() const {
+    if (!injection_.empty() || overflowSize_.load(std::memory_order_acquire) > 0) {
+        return true;
+    }
+
+    for (const auto& queue : queues_) {
+        if (!queue->deque.empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::park() {
+    std::unique_lock<std::mutex> lock(parkMutex_);
+    uint64_t seen = wakeups_;
+
+    //Announce before the last look: a submit either sees the sleeper and
+    //wakes it, or pushed early enough for hasWork() to see the job
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!hasWork() && !stop_.load(std::memory_order_acquire)) {
+        condition_.wait(lock, [this, seen] {
+            return wakeups_ != seen || stop_.load(std::memory_order_acquire);
+        });
+    }
+
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ThreadPool::wakeOne() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(parkMutex_);
+        wakeups_++;
+    }
+    condition_.notify_one();
+}
+
+void ThreadPool::run(Job* job) {
+    std::unique_ptr<Job> owned(job);
+
+    // Execute task (outside any lock!)
+    try {
+        (*owned)();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Task threw exception: " + std::string(e.what()));
+    } catch (...) {
+        LOG_ERROR("Task threw unknown exception");
+    }
+}
@@ -0,0 +1,462 @@
+#include "TransferEngine.h"
+#include "HttpClient.h"
+#include "Logger.h"
+#include <algorithm>
+
+// Upper bound on a single poll so stop requests are noticed promptly
+static const int MAX_POLL_MS = 1000;
+
+TransferEngine::TransferEngine()
+    : multi_(curl_multi_init())
+    , stop_(false)
+    , nextId_(1)
+    , transferCount_(0)
+{
+    if (!multi_) {
+        LOG_ERROR("Failed to create curl multi handle");
+    }
+}
+
+TransferEngine::~TransferEngine() {
+    stop();
+    abortAll();
+
+    if (multi_) {
+        curl_multi_cleanup(multi_);
+    }
+}
+
+void TransferEngine::start() {
+    if (loopThread_.joinable()) {
+        return; // Already running
+    }
+
+    stop_.store(false);
+    loopThread_ = std::thread([this] {
+        loop(false);
+    });
+    LOG_INFO("Transfer engine started");
+}
+
+void TransferEngine::stop() {
+    if (!loopThread_.joinable()) {
+        return;
+    }
+
+    stop_.store(true);
+    curl_multi_wakeup(multi_);
+    loopThread_.join();
+    LOG_INFO("Transfer engine stopped");
+}
+
+void TransferEngine::run() {
+    stop_.store(false);
+    loop(true);
+}
+
+TransferEngine::TransferId TransferEngine::submit(CurlHttpClient* client, CompletionCallback onDone) {
+    auto transfer = std::make_shared<Transfer>();
+    transfer->client = client;
+    transfer->onDone = std::move(onDone);
+
+    //Write callbacks run on the loop thread, so the timer needs no lock
+    client->set_pause_listener([this](CURL* easy, Clock::time_point resumeAt) {
+        throttleTimers_.emplace(resumeAt, easy);
+    });
+
+    transferCount_.fetch_add(1);
+    TransferId id = 0;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        id = nextId_++;
+        transfer->id = id;
+        pending_.push_back(std::move(transfer));
+    }
+
+    //Interrupt curl_multi_poll so the loop picks it up immediately
+    curl_multi_wakeup(multi_);
+    return id;
+}
+
+void TransferEngine::interrupt(TransferId id) {
+    sendCommand(Command{Command::Kind::Interrupt, id, std::chrono::milliseconds(0), nullptr, nullptr});
+}
+
+void TransferEngine::hold(TransferId id, std::chrono::milliseconds maxHold, HoldCallback onHeld, ExpiryCallback onExpire) {
+    sendCommand(Command{Command::Kind::Hold, id, maxHold, std::move(onHeld), std::move(onExpire)});
+}
+
+void TransferEngine::release(TransferId id) {
+    sendCommand(Command{Command::Kind::Release, id, std::chrono::milliseconds(0), nullptr, nullptr});
+}
+
+void TransferEngine::sendCommand(Command command) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        commands_.push_back(std::move(command));
+    }
+    curl_multi_wakeup(multi_);
+}
+
+void TransferEngine::setMaxHostConnections(long maxConnections) {
+    if (multi_) {
+        curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, maxConnections);
+    }
+}
+
+size_t TransferEngine::getActiveCount() const {
+    return transferCount_.load();
+}
+
+void TransferEngine::loop(bool untilIdle) {
+    if (!multi_) {
+        abortAll();
+        return;
+    }
+
+    while (!stop_.load()) {
+        addPending();
+        processCommands();
+        fireRetryTimers();
+        fireThrottleTimers();
+        fireHoldTimers();
+
+        if (untilIdle && idle()) {
+            break;
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+        processMessages();
+
+        if (untilIdle && idle()) {
+            break;
+        }
+
+        //Sleep until socket activity, a curl timeout, a retry timer or a wakeup
+        int numfds = 0;
+        curl_multi_poll(multi_, nullptr, 0, nextTimeoutMs(), &numfds);
+    }
+}
+
+void TransferEngine::addPending() {
+    std::vector<std::shared_ptr<Transfer>> pending;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        pending.swap(pending_);
+    }
+
+    for (auto& transfer : pending) {
+        transfers_[transfer->id] = transfer;
+        beginAttempt(transfer);
+    }
+}
+
+void TransferEngine::processCommands() {
+    std::vector<Command> commands;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        commands.swap(commands_);
+    }
+
+    for (const Command& command : commands) {
+        auto it = transfers_.find(command.id);
+        if (it == transfers_.end()) {
+            continue; //Already completed
+        }
+        std::shared_ptr<Transfer> transfer = it->second;
+
+        switch (command.kind) {
+        case Command::Kind::Interrupt:
+            stopTransfer(transfer);
+            break;
+        case Command::Kind::Hold:
+            holdTransfer(transfer, command);
+            break;
+        case Command::Kind::Release:
+            releaseTransfer(transfer);
+            break;
+        }
+    }
+}
+
+void TransferEngine::stopTransfer(const std::shared_ptr<Transfer>& transfer) {
+    transfer->client->stop();
+
+    //Let the client close its files and keep its resume state, as for a stop
+    //seen in a callback; parked on a retry timer it has already done so
+    if (!transfer->handles.empty()) {
+        CURL* easy = transfer->handles.front();
+        curl_multi_remove_handle(multi_, easy);
+        active_.erase(easy);
+        transfer->handles.erase(transfer->handles.begin());
+        transfer->client->finish_handle(easy, CURLE_ABORTED_BY_CALLBACK);
+    }
+
+    detachAll(transfer);
+    complete(transfer, false);
+}
+
+void TransferEngine::holdTransfer(const std::shared_ptr<Transfer>& transfer, const Command& command) {
+    if (transfer->handles.empty()) {
+        if (command.onExpire && command.onExpire()) {
+            stopTransfer(transfer);
+        }
+        return;
+    }
+
+    //Bytes already on the wire wait in the socket buffers until release()
+    for (CURL* easy : transfer->handles) {
+        curl_easy_pause(easy, CURLPAUSE_RECV);
+    }
+    transfer->held = true;
+    transfer->onExpire = command.onExpire;
+    holdTimers_.emplace(Clock::now() + command.maxHold, transfer->id);
+
+    if (command.onHeld) {
+        command.onHeld();
+    }
+}
+
+void TransferEngine::releaseTransfer(const std::shared_ptr<Transfer>& transfer) {
+    if (!transfer->held) {
+        return;
+    }
+
+    transfer->held = false;
+    transfer->onExpire = nullptr;
+    for (auto it = holdTimers_.begin(); it != holdTimers_.end();) {
+        it = it->second == transfer->id ? holdTimers_.erase(it) : std::next(it);
+    }
+
+    //A handle the bandwidth cap paused re-pauses itself if it is still over
+    for (CURL* easy : transfer->handles) {
+        curl_easy_pause(easy, CURLPAUSE_CONT);
+    }
+}
+
+void TransferEngine::fireHoldTimers() {
+    auto now = Clock::now();
+
+    while (!holdTimers_.empty() && holdTimers_.begin()->first <= now) {
+        TransferId id = holdTimers_.begin()->second;
+        holdTimers_.erase(holdTimers_.begin());
+
+        auto it = transfers_.find(id);
+        if (it == transfers_.end() || !it->second->held) {
+            continue;
+        }
+
+        //Held too long: give the connections up, unless the owner resumed it meanwhile
+        std::shared_ptr<Transfer> transfer = it->second;
+        ExpiryCallback onExpire = std::move(transfer->onExpire);
+        transfer->onExpire = nullptr;
+        if (!onExpire || onExpire()) {
+            stopTransfer(transfer);
+        }
+    }
+}
+
+void TransferEngine::beginAttempt(const std::shared_ptr<Transfer>& transfer) {
+    if (!transfer->client->begin_attempt() || !addReadyHandles(transfer)) {
+        detachAll(transfer);
+        complete(transfer, false);
+    }
+}
+
+bool TransferEngine::addReadyHandles(const std::shared_ptr<Transfer>& transfer) {
+    for (CURL* easy : transfer->client->take_ready_handles()) {
+        CURLMcode rc = curl_multi_add_handle(multi_, easy);
+        if (rc != CURLM_OK) {
+            LOG_ERROR("Failed to add transfer to multi handle: " + std::string(curl_multi_strerror(rc)));
+            transfer->client->finish_handle(easy, CURLE_FAILED_INIT);
+            return false;
+        }
+
+        transfer->handles.push_back(easy);
+        active_[easy] = transfer;
+
+        //Re-armed (retry, next segment) while held: stays quiet too
+        if (transfer->held) {
+            curl_easy_pause(easy, CURLPAUSE_RECV);
+        }
+    }
+    return true;
+}
+
+void TransferEngine::processMessages() {
+    CURLMsg* msg = nullptr;
+    int queued = 0;
+
+    while ((msg = curl_multi_info_read(multi_, &queued)) != nullptr) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        CURL* easy = msg->easy_handle;
+        CURLcode res = msg->data.result;
+
+        auto it = active_.find(easy);
+        if (it == active_.end()) {
+            continue;
+        }
+
+        std::shared_ptr<Transfer> transfer = it->second;
+        active_.erase(it);
+        curl_multi_remove_handle(multi_, easy);
+
+        //It may have ended while throttle-paused (timeout). The handle goes back
+        //to the pool or gets re-armed, so a leftover timer would unpause its next use early
+        dropThrottleTimers(easy);
+        auto& handles = transfer->handles;
+        handles.erase(std::remove(handles.begin(), handles.end(), easy), handles.end());
+
+        switch (transfer->client->finish_handle(easy, res)) {
+        case TransferStatus::Running:
+            // Other handles still in flight; the client may have armed new ones
+            if (!addReadyHandles(transfer)) {
+                detachAll(transfer);
+                complete(transfer, false);
+            }
+            break;
+        case TransferStatus::RetryLater: {
+            // Backoff without blocking the loop: park the handle on a timer
+            auto due = Clock::now() + transfer->client->retry_delay();
+            retryTimers_.emplace(due, RetryTimer{transfer, easy});
+            break;
+        }
+        case TransferStatus::Restart:
+            detachAll(transfer);
+            beginAttempt(transfer);
+            break;
+        case TransferStatus::Succeeded:
+            complete(transfer, true);
+            break;
+        case TransferStatus::Failed:
+        case TransferStatus::Stopped:
+            detachAll(transfer);
+            complete(transfer, false);
+            break;
+        }
+    }
+}
+
+void TransferEngine::fireRetryTimers() {
+    auto now = Clock::now();
+
+    while (!retryTimers_.empty() && retryTimers_.begin()->first <= now) {
+        RetryTimer timer = retryTimers_.begin()->second;
+        retryTimers_.erase(retryTimers_.begin());
+
+        if (!timer.transfer->client->retry_handle(timer.handle) || !addReadyHandles(timer.transfer)) {
+            detachAll(timer.transfer);
+            complete(timer.transfer, false);
+        }
+    }
+}
+
+void TransferEngine::fireThrottleTimers() {
+    auto now = Clock::now();
+
+    //Unpausing may deliver data that pauses the handle again, always for a later time
+    while (!throttleTimers_.empty() && throttleTimers_.begin()->first <= now) {
+        CURL* easy = throttleTimers_.begin()->second;
+        throttleTimers_.erase(throttleTimers_.begin());
+
+        //A held transfer stays paused; release() continues it
+        auto it = active_.find(easy);
+        if (it != active_.end() && !it->second->held) {
+            curl_easy_pause(easy, CURLPAUSE_CONT);
+        }
+    }
+}
+
+void TransferEngine::dropThrottleTimers(CURL* easy) {
+    for (auto it = throttleTimers_.begin(); it != throttleTimers_.end();) {
+        it = it->second == easy ? throttleTimers_.erase(it) : std::next(it);
+    }
+}
+
+void TransferEngine::detachAll(const std::shared_ptr<Transfer>& transfer) {
+    //Pull sibling handles out of the multi before the client tears them down
+    for (CURL* easy : transfer->handles) {
+        curl_multi_remove_handle(multi_, easy);
+        active_.erase(easy);
+        dropThrottleTimers(easy);
+    }
+    transfer->handles.clear();
+
+    for (auto it = retryTimers_.begin(); it != retryTimers_.end();) {
+        if (it->second.transfer == transfer) {
+            it = retryTimers_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TransferEngine::complete(const std::shared_ptr<Transfer>& transfer, bool success) {
+    //Move the callback out so it runs (and releases the client it owns) only once
+    CompletionCallback onDone = std::move(transfer->onDone);
+    transfer->onDone = nullptr;
+
+    transferCount_.fetch_sub(1);
+    transfers_.erase(transfer->id);
+
+    if (onDone) {
+        onDone(success);
+    }
+}
+
+void TransferEngine::abortAll() {
+    if (!active_.empty() || !retryTimers_.empty()) {
+        LOG_WARN("Transfer engine shutting down with unfinished transfers");
+    }
+
+    for (auto& entry : active_) {
+        curl_multi_remove_handle(multi_, entry.first);
+    }
+    active_.clear();
+    transfers_.clear();
+    retryTimers_.clear();
+    throttleTimers_.clear();
+    holdTimers_.clear();
+    transferCount_.store(0);
+
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    pending_.clear();
+    commands_.clear();
+}
+
+bool TransferEngine::idle() {
+    if (!active_.empty() || !retryTimers_.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    return pending_.empty();
+}
+
+int TransferEngine::nextTimeoutMs() const {
+    if (retryTimers_.empty() && throttleTimers_.empty() && holdTimers_.empty()) {
+        return MAX_POLL_MS;
+    }
+
+    Clock::time_point due = Clock::time_point::max();
+    if (!retryTimers_.empty()) {
+        due = retryTimers_.begin()->first;
+    }
+    if (!throttleTimers_.empty()) {
+        due = std::min(due, throttleTimers_.begin()->first);
+    }
+    if (!holdTimers_.empty()) {
+        due = std::min(due, holdTimers_.begin()->first);
+    }
+
+    auto untilDue = std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now()).count();
+
+    if (untilDue < 0) {
+        return 0;
+    }
+    return static_cast<int>(std::min<long long>(untilDue, MAX_POLL_MS));
+}
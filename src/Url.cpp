@@ -0,0 +1,35 @@
+#include "Url.h"
+#include <cctype>
+
+std::string hostFromUrl(const std::string& url) {
+    size_t start = url.find("://");
+    std::string scheme = start == std::string::npos ? "" : url.substr(0, start);
+    start = start == std::string::npos ? 0 : start + 3;
+
+    size_t end = url.find_first_of("/?#", start);
+    std::string authority = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+
+    //Drop credentials
+    size_t at = authority.rfind('@');
+    if (at != std::string::npos) {
+        authority = authority.substr(at + 1);
+    }
+
+    for (auto& c : authority) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (authority.empty()) {
+        return "";
+    }
+
+    //Same host on the default port is the same origin ("[::1]:80" has its colon after the bracket)
+    size_t bracket = authority.rfind(']');
+    size_t colon = authority.rfind(':');
+    if (colon == std::string::npos || (bracket != std::string::npos && colon < bracket)) {
+        for (auto& c : scheme) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        authority += scheme == "https" ? ":443" : scheme == "ftp" ? ":21" : ":80";
+    }
+    return authority;
+}
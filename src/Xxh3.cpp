@@ -0,0 +1,287 @@
+#include "Xxh3.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t PRIME32_1 = 0x9E3779B1U;
+static const uint32_t PRIME32_2 = 0x85EBCA77U;
+static const uint32_t PRIME32_3 = 0xC2B2AE3DU;
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+static const uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+static const uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+static const size_t STRIPE_LEN = 64;
+static const size_t SECRET_SIZE = 192;
+static const size_t STRIPES_PER_BLOCK = (SECRET_SIZE - STRIPE_LEN) / 8;
+static const size_t SECRET_LIMIT = SECRET_SIZE - STRIPE_LEN;
+static const size_t MIDSIZE_MAX = 240;
+
+static const uint8_t SECRET[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline uint32_t read32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static inline uint64_t read64(const uint8_t* p) {
+    return static_cast<uint64_t>(read32(p)) | static_cast<uint64_t>(read32(p + 4)) << 32;
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t swap64(uint64_t x) {
+    return __builtin_bswap64(x);
+}
+
+static inline uint64_t mul128_fold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t rrmxmx(uint64_t h, uint64_t len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static inline uint64_t mix16(const uint8_t* in, const uint8_t* secret) {
+    return mul128_fold64(read64(in) ^ read64(secret), read64(in + 8) ^ read64(secret + 8));
+}
+
+// Inputs of up to 240 bytes are hashed in one go
+static uint64_t hash_short(const uint8_t* in, size_t len) {
+    if (len == 0) {
+        return xxh64_avalanche(read64(SECRET + 56) ^ read64(SECRET + 64));
+    }
+    if (len <= 3) {
+        uint32_t combined = static_cast<uint32_t>(in[0]) << 16 | static_cast<uint32_t>(in[len >> 1]) << 24 |
+                            static_cast<uint32_t>(in[len - 1]) | static_cast<uint32_t>(len) << 8;
+        uint64_t bitflip = read32(SECRET) ^ read32(SECRET + 4);
+        return xxh64_avalanche(combined ^ bitflip);
+    }
+    if (len <= 8) {
+        uint64_t input64 = read32(in + len - 4) + (static_cast<uint64_t>(read32(in)) << 32);
+        uint64_t bitflip = read64(SECRET + 8) ^ read64(SECRET + 16);
+        return rrmxmx(input64 ^ bitflip, len);
+    }
+    if (len <= 16) {
+        uint64_t lo = read64(in) ^ (read64(SECRET + 24) ^ read64(SECRET + 32));
+        uint64_t hi = read64(in + len - 8) ^ (read64(SECRET + 40) ^ read64(SECRET + 48));
+        return avalanche(len + swap64(lo) + hi + mul128_fold64(lo, hi));
+    }
+
+    uint64_t acc = len * PRIME64_1;
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += mix16(in + 48, SECRET + 96);
+                    acc += mix16(in + len - 64, SECRET + 112);
+                }
+                acc += mix16(in + 32, SECRET + 64);
+                acc += mix16(in + len - 48, SECRET + 80);
+            }
+            acc += mix16(in + 16, SECRET + 32);
+            acc += mix16(in + len - 32, SECRET + 48);
+        }
+        acc += mix16(in, SECRET);
+        acc += mix16(in + len - 16, SECRET + 16);
+        return avalanche(acc);
+    }
+
+    size_t rounds = len / 16;
+    for (size_t i = 0; i < 8; i++) {
+        acc += mix16(in + 16 * i, SECRET + 16 * i);
+    }
+    acc = avalanche(acc);
+    for (size_t i = 8; i < rounds; i++) {
+        acc += mix16(in + 16 * i, SECRET + 16 * (i - 8) + 3);
+    }
+    acc += mix16(in + len - 16, SECRET + 136 - 17);
+    return avalanche(acc);
+}
+
+// The stripe loop is the hot path; it vectorizes well, so build an AVX2
+// copy next to the baseline one and let the loader pick.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && !defined(__clang__)
+#define ACCUMULATE_DISPATCH __attribute__((target_clones("avx2", "default")))
+#else
+#define ACCUMULATE_DISPATCH
+#endif
+
+ACCUMULATE_DISPATCH
+static void accumulate(uint64_t acc[8], const uint8_t* in, const uint8_t* secret, size_t stripes) {
+    for (size_t s = 0; s < stripes; s++) {
+        const uint8_t* stripe = in + s * STRIPE_LEN;
+        const uint8_t* key = secret + s * 8;
+        for (size_t i = 0; i < 8; i++) {
+            uint64_t data_val = read64(stripe + 8 * i);
+            uint64_t data_key = data_val ^ read64(key + 8 * i);
+            acc[i ^ 1] += data_val;
+            acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+        }
+    }
+}
+
+static void scramble(uint64_t acc[8]) {
+    const uint8_t* secret = SECRET + SECRET_LIMIT;
+    for (size_t i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(secret + 8 * i);
+        a *= PRIME32_1;
+        acc[i] = a;
+    }
+}
+
+// Accumulate stripes continuing a block that already has stripes_so_far done,
+// scrambling at every block boundary
+static void consume_stripes(uint64_t acc[8], size_t& stripes_so_far, const uint8_t* in, size_t stripes) {
+    while (stripes > 0) {
+        size_t count = std::min(STRIPES_PER_BLOCK - stripes_so_far, stripes);
+        accumulate(acc, in, SECRET + stripes_so_far * 8, count);
+        in += count * STRIPE_LEN;
+        stripes -= count;
+        stripes_so_far += count;
+
+        if (stripes_so_far == STRIPES_PER_BLOCK) {
+            scramble(acc);
+            stripes_so_far = 0;
+        }
+    }
+}
+
+static uint64_t merge_accs(const uint64_t acc[8], uint64_t start) {
+    const uint8_t* secret = SECRET + 11;
+    uint64_t result = start;
+    for (size_t i = 0; i < 4; i++) {
+        result += mul128_fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+    }
+    return avalanche(result);
+}
+
+Xxh3::Xxh3() {
+    reset();
+}
+
+void Xxh3::reset() {
+    acc_[0] = PRIME32_3;
+    acc_[1] = PRIME64_1;
+    acc_[2] = PRIME64_2;
+    acc_[3] = PRIME64_3;
+    acc_[4] = PRIME64_4;
+    acc_[5] = PRIME32_2;
+    acc_[6] = PRIME64_5;
+    acc_[7] = PRIME32_1;
+    std::memset(buffer_, 0, sizeof(buffer_));
+    buffered_ = 0;
+    stripes_so_far_ = 0;
+    total_len_ = 0;
+}
+
+void Xxh3::update(const void* data, size_t length) {
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+    total_len_ += length;
+
+    if (buffered_ + length <= BUFFER_SIZE) {
+        std::memcpy(buffer_ + buffered_, input, length);
+        buffered_ += length;
+        return;
+    }
+
+    // The last bytes always stay buffered: the final stripe is special
+    if (buffered_ > 0) {
+        size_t fill = BUFFER_SIZE - buffered_;
+        std::memcpy(buffer_ + buffered_, input, fill);
+        input += fill;
+        length -= fill;
+        consume_stripes(acc_, stripes_so_far_, buffer_, BUFFER_SIZE / STRIPE_LEN);
+        buffered_ = 0;
+    }
+
+    if (length > BUFFER_SIZE) {
+        // Straight from the input, without copying through the buffer
+        size_t stripes = (length - 1) / STRIPE_LEN;
+        consume_stripes(acc_, stripes_so_far_, input, stripes);
+        input += stripes * STRIPE_LEN;
+        length -= stripes * STRIPE_LEN;
+
+        // digest() may need the bytes just before what stays buffered
+        std::memcpy(buffer_ + BUFFER_SIZE - STRIPE_LEN, input - STRIPE_LEN, STRIPE_LEN);
+    }
+
+    std::memcpy(buffer_, input, length);
+    buffered_ = length;
+}
+
+uint64_t Xxh3::digest() const {
+    if (total_len_ <= MIDSIZE_MAX) {
+        return hash_short(buffer_, static_cast<size_t>(total_len_));
+    }
+
+    uint64_t acc[8];
+    std::memcpy(acc, acc_, sizeof(acc));
+    size_t stripes_so_far = stripes_so_far_;
+
+    uint8_t last_stripe[STRIPE_LEN];
+    if (buffered_ >= STRIPE_LEN) {
+        size_t stripes = (buffered_ - 1) / STRIPE_LEN;
+        consume_stripes(acc, stripes_so_far, buffer_, stripes);
+        std::memcpy(last_stripe, buffer_ + buffered_ - STRIPE_LEN, STRIPE_LEN);
+    } else {
+        // Complete the stripe with bytes that were already consumed
+        size_t catchup = STRIPE_LEN - buffered_;
+        std::memcpy(last_stripe, buffer_ + BUFFER_SIZE - catchup, catchup);
+        std::memcpy(last_stripe + catchup, buffer_, buffered_);
+    }
+    accumulate(acc, last_stripe, SECRET + SECRET_LIMIT - 7, 1);
+
+    return merge_accs(acc, total_len_ * PRIME64_1);
+}